@@ -0,0 +1,85 @@
+#include "FirTables.hpp"
+#include "SIDDefs.hpp"
+
+using namespace reSID;
+
+extern InterfaceTable* ft;
+
+namespace SIDOsc {
+
+namespace {
+
+// A table build; method < 0 builds both resampling tables.
+struct PrepareJob {
+    double clockFreq;
+    double sampleFreq;
+    int method;
+};
+
+bool prepareTables(World*, void* data) {
+    const PrepareJob* job = static_cast<const PrepareJob*>(data);
+    for (int method = SAMPLE_RESAMPLE; method <= SAMPLE_RESAMPLE_FASTMEM; method++) {
+        if (job->method >= 0 && job->method != method) {
+            continue;
+        }
+        if (!SID::prepare_fir_table(job->clockFreq, static_cast<sampling_method>(method), job->sampleFreq)) {
+            Print("SIDOsc: no FIR table for sampling method %d at %g Hz\n", method, job->sampleFreq);
+        }
+    }
+    return true;
+}
+
+void freeJob(World* world, void* data) {
+    RTFree(world, data);
+}
+
+// Called on the real-time thread; the build runs in stage 2, on the non
+// real-time thread. Hosts without a separate thread run it right away.
+void queuePrepare(World* world, void* replyAddr, double clockFreq, double sampleFreq, int method) {
+    PrepareJob* job = static_cast<PrepareJob*>(RTAlloc(world, sizeof(PrepareJob)));
+    if (!job) {
+        return;
+    }
+    job->clockFreq = clockFreq;
+    job->sampleFreq = sampleFreq;
+    job->method = method;
+    DoAsynchronousCommand(world, replyAddr, "sidosc_prepare", job, prepareTables, nullptr, nullptr, freeJob, 0,
+                          nullptr);
+}
+
+void prepareCmd(World* world, void*, sc_msg_iter* args, void* replyAddr) {
+    const int method = args->geti(-1);
+    // The server rate is taken as is, since tables are looked up by exact rate.
+    const double sampleFreq = args->remain() > 0 ? args->getf() : world->mSampleRate;
+    if (method >= 0 && method != SAMPLE_RESAMPLE && method != SAMPLE_RESAMPLE_FASTMEM) {
+        Print("sidosc_prepare: sampling method %d has no FIR table\n", method);
+        return;
+    }
+    queuePrepare(world, replyAddr, kClockFreq, sampleFreq, method);
+}
+
+} // namespace
+
+sampling_method setUnitSampling(Unit* unit, SID& sid, double clockFreq, sampling_method method, double sampleFreq,
+                                const char* unitName) {
+    sid.enable_fir_table_build(false);
+    if (sid.set_sampling_parameters(clockFreq, method, sampleFreq)) {
+        return method;
+    }
+    if (method == SAMPLE_RESAMPLE || method == SAMPLE_RESAMPLE_FASTMEM) {
+        queuePrepare(unit->mWorld, nullptr, clockFreq, sampleFreq, method);
+        if (sid.set_sampling_parameters(clockFreq, method, sampleFreq)) {
+            return method;
+        }
+    }
+    Print("%s: sampling method %d not prepared or supported at %g Hz, or out of real-time memory, using SAMPLE_FAST\n",
+          unitName, static_cast<int>(method), sampleFreq);
+    sid.set_sampling_parameters(clockFreq, SAMPLE_FAST, sampleFreq);
+    return SAMPLE_FAST;
+}
+
+void definePrepareCmd() {
+    DefinePlugInCmd("sidosc_prepare", prepareCmd, nullptr);
+}
+
+} // namespace SIDOsc
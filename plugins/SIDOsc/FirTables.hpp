@@ -0,0 +1,27 @@
+#pragma once
+
+#include "SC_PlugIn.hpp"
+#include "sid.h"
+
+namespace SIDOsc {
+
+// Resampling FIR tables for the units.
+//
+// A table takes from milliseconds (SAMPLE_RESAMPLE) up to a good part of a
+// second (SAMPLE_RESAMPLE_FASTMEM) to build, so node constructors only look
+// it up in the reSID cache. On a miss the table is built by an asynchronous
+// command on the non real-time thread, and the node plays SAMPLE_FAST; nodes
+// started after the build use the table. /cmd "sidosc_prepare" builds the
+// tables ahead.
+
+// Sets up the sampling of a unit's SID for its sample rate, and returns the
+// method in use, which is SAMPLE_FAST if the requested one is unavailable.
+reSID::sampling_method setUnitSampling(Unit* unit, reSID::SID& sid, double clockFreq, reSID::sampling_method method,
+                                       double sampleFreq, const char* unitName);
+
+// /cmd "sidosc_prepare" [sampling] [sampleRate]
+// Builds the FIR table of sampling method 2 or 3 (both by default) at the
+// server's sample rate or the given one; replies /done sidosc_prepare.
+void definePrepareCmd();
+
+} // namespace SIDOsc
@@ -0,0 +1,94 @@
+#pragma once
+
+// Optional per-node counters, enabled with the INSTRUMENT CMake option.
+// With SIDOSC_INSTRUMENT 0 the macros below expand to nothing and the units
+// carry no extra state.
+
+#ifndef SIDOSC_INSTRUMENT
+#define SIDOSC_INSTRUMENT 0
+#endif
+
+#if SIDOSC_INSTRUMENT
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace SIDOsc {
+
+// Totals over all nodes of a UGen, added to as nodes are freed.
+struct AggregateStats {
+    std::atomic<uint64_t> nodes{ 0 };
+    std::atomic<uint64_t> calls{ 0 };
+    std::atomic<uint64_t> samples{ 0 };
+    std::atomic<uint64_t> cycles{ 0 };
+    std::atomic<uint64_t> registerWrites{ 0 };
+    std::atomic<uint64_t> convolutions{ 0 };
+    std::atomic<uint64_t> clockNanos{ 0 };
+    std::atomic<uint64_t> nextNanos{ 0 };
+};
+
+inline AggregateStats sidOscTotals;
+inline AggregateStats sidOscFullTotals;
+
+// Counters of one node. Cycles are SID cycles clocked, convolutions the FIR
+// convolutions of the resampling methods; clockNanos is the time spent in
+// SID::clock() and nextNanos the time spent in the calc function.
+struct NodeStats {
+    explicit NodeStats(AggregateStats& totals) : mTotals(totals) {}
+    NodeStats(const NodeStats&) = delete;
+    NodeStats& operator=(const NodeStats&) = delete;
+
+    ~NodeStats() {
+        mTotals.nodes += 1;
+        mTotals.calls += calls;
+        mTotals.samples += samples;
+        mTotals.cycles += cycles;
+        mTotals.registerWrites += registerWrites;
+        mTotals.convolutions += convolutions;
+        mTotals.clockNanos += clockNanos;
+        mTotals.nextNanos += nextNanos;
+    }
+
+    uint64_t calls = 0;
+    uint64_t samples = 0;
+    uint64_t cycles = 0;
+    uint64_t registerWrites = 0;
+    uint64_t convolutions = 0;
+    uint64_t clockNanos = 0;
+    uint64_t nextNanos = 0;
+
+private:
+    AggregateStats& mTotals;
+};
+
+// Adds the lifetime of the timer to a nanosecond counter.
+class ScopedTimer {
+public:
+    explicit ScopedTimer(uint64_t& nanos) : mNanos(nanos), mStart(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        mNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mStart).count();
+    }
+
+private:
+    uint64_t& mNanos;
+    std::chrono::steady_clock::time_point mStart;
+};
+
+} // namespace SIDOsc
+
+#define SIDOSC_COUNT(counter, n) (mStats.counter += (n))
+#define SIDOSC_TIME(counter) ::SIDOsc::ScopedTimer scopedTimer_##counter(mStats.counter)
+// Entry of a calc function: counts the call and its samples, and times it.
+#define SIDOSC_BLOCK(nSamples) \
+    SIDOSC_COUNT(calls, 1); \
+    SIDOSC_COUNT(samples, nSamples); \
+    SIDOSC_TIME(nextNanos)
+
+#else
+
+#define SIDOSC_COUNT(counter, n) ((void)0)
+#define SIDOSC_TIME(counter) ((void)0)
+#define SIDOSC_BLOCK(nSamples) ((void)0)
+
+#endif // SIDOSC_INSTRUMENT
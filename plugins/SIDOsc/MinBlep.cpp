@@ -0,0 +1,118 @@
+#include "MinBlep.hpp"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+namespace SIDOsc {
+
+using Spectrum = std::vector<std::complex<double>>;
+
+// Zero crossings of the windowed sinc on each side of its centre.
+static constexpr int kZeroCrossings = 8;
+// FFT size for the cepstrum, zero padded well beyond the sinc length to
+// keep the cepstral aliasing low.
+static constexpr int kFftSize = 4096;
+static constexpr double kPi = 3.14159265358979323846;
+
+float gMinBlepResidual[kMinBlepPhases + 1][kMinBlepTaps];
+double gMinBlepDelay = 0.0;
+
+// In-place radix-2 FFT; inverse without the 1/N scaling.
+static void fft(Spectrum& x, bool inverse) {
+    const int n = static_cast<int>(x.size());
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(x[i], x[j]);
+        }
+    }
+    for (int length = 2; length <= n; length <<= 1) {
+        const double angle = (inverse ? 2.0 : -2.0) * kPi / length;
+        const std::complex<double> step(std::cos(angle), std::sin(angle));
+        for (int i = 0; i < n; i += length) {
+            std::complex<double> w(1.0);
+            for (int k = 0; k < length / 2; k++) {
+                const std::complex<double> a = x[i + k];
+                const std::complex<double> b = x[i + k + length / 2] * w;
+                x[i + k] = a + b;
+                x[i + k + length / 2] = a - b;
+                w *= step;
+            }
+        }
+    }
+}
+
+// The minimum phase version of the windowed sinc is found through the real
+// cepstrum; its running sum is the band-limited step.
+void buildMinBlep() {
+    constexpr int sincLength = 2 * kZeroCrossings * kMinBlepPhases + 1;
+    Spectrum x(kFftSize, 0.0);
+    for (int i = 0; i < sincLength; i++) {
+        const double t = static_cast<double>(i - kZeroCrossings * kMinBlepPhases) / kMinBlepPhases;
+        const double sinc = (t == 0.0) ? 1.0 : std::sin(kPi * t) / (kPi * t);
+        const double phase = 2.0 * kPi * i / (sincLength - 1);
+        const double blackman = 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase);
+        x[i] = sinc * blackman;
+    }
+
+    // Real cepstrum.
+    fft(x, false);
+    for (auto& bin : x) {
+        bin = std::log(std::max(std::abs(bin), 1e-50));
+    }
+    fft(x, true);
+    for (auto& c : x) {
+        c = c.real() / kFftSize;
+    }
+
+    // Fold the anticausal part onto the causal part.
+    for (int i = 1; i < kFftSize / 2; i++) {
+        x[i] *= 2.0;
+    }
+    for (int i = kFftSize / 2 + 1; i < kFftSize; i++) {
+        x[i] = 0.0;
+    }
+
+    fft(x, false);
+    for (auto& bin : x) {
+        bin = std::exp(bin);
+    }
+    fft(x, true);
+
+    // Running sum, normalized to end at exactly 1 after kMinBlepTaps samples.
+    constexpr int stepLength = kMinBlepTaps * kMinBlepPhases + 1;
+    std::vector<double> step(stepLength);
+    double sum = 0.0;
+    for (int i = 0; i < stepLength; i++) {
+        sum += x[i].real();
+        step[i] = sum;
+    }
+    for (double& value : step) {
+        value /= sum;
+    }
+
+    // The delay at which an ideal step has the same area as the band-limited
+    // one, which leaves the residuals without DC. It sits halfway between two
+    // table phases: minBlepResidual() rounds to the nearest phase, and has
+    // to agree with the naive waveform on which sample the step falls.
+    double area = 0.0;
+    for (int i = 0; i < stepLength - 1; i++) {
+        area += 1.0 - step[i];
+    }
+    const int delay = static_cast<int>(area) + 1;
+    gMinBlepDelay = (delay - 0.5) / kMinBlepPhases;
+
+    for (int p = 0; p <= kMinBlepPhases; p++) {
+        for (int k = 0; k < kMinBlepTaps; k++) {
+            const int i = k * kMinBlepPhases + p;
+            gMinBlepResidual[p][k] = static_cast<float>(step[i] - (i >= delay ? 1.0 : 0.0));
+        }
+    }
+}
+
+} // namespace SIDOsc
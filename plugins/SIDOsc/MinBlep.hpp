@@ -0,0 +1,34 @@
+#pragma once
+
+namespace SIDOsc {
+
+// Minimum phase band-limited step (minBLEP), after Brandt, "Hard Sync
+// Without Aliasing" (ICMC 2001).
+//
+// A waveform step between two samples is rendered as the naive step plus a
+// residual: the difference between the band-limited step and the ideal one.
+// The residual is causal, so it is added to the current and the following
+// samples, without any lookahead. It is tabulated for kMinBlepPhases
+// positions of the step between two samples.
+//
+// A minimum phase step rises late, by gMinBlepDelay samples on average. The
+// residuals are taken against an ideal step delayed by as much, so the naive
+// waveform has to be rendered that late too; otherwise every edge would be
+// shifted against the rest of the waveform, and add DC that grows with the
+// frequency.
+static constexpr int kMinBlepTaps   = 16; // power of two, for ring buffers
+static constexpr int kMinBlepPhases = 64;
+
+// Build the table; call once from the loading thread.
+void buildMinBlep();
+
+extern float gMinBlepResidual[kMinBlepPhases + 1][kMinBlepTaps];
+extern double gMinBlepDelay;
+
+// Residual of a unit step that happened delay samples (0-1) before the
+// current sample, for the current sample and the kMinBlepTaps - 1 after it.
+inline const float* minBlepResidual(float delay) {
+    return gMinBlepResidual[static_cast<int>(delay * kMinBlepPhases + 0.5f)];
+}
+
+} // namespace SIDOsc
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "sid.h"
+#include <cassert>
+
+namespace SIDOsc {
+
+// A SID register write, timestamped in cycles from the start of a chunk.
+struct RegisterWrite {
+    reSID::cycle_count cycle;
+    reSID::reg8 address;
+    reSID::reg8 value;
+};
+
+// Register writes for one chunk of samples, in cycle order. render() delta
+// clocks the SID from one write to the next, so that each write lands on its
+// cycle instead of being collapsed to a block boundary.
+class RegisterQueue {
+public:
+    // Samples per chunk, and the writes a chunk can hold: a FREQ_LO and a
+    // FREQ_HI write per voice for every sample, plus the control, envelope
+    // and filter registers written once at the start of a block.
+    static constexpr int kChunkSamples = 64;
+    static constexpr int kWritesPerSample = 3 * 2;
+    static constexpr int kWritesPerBlock = 3 + 3 * 2 + 4;
+    static constexpr int kCapacity = kChunkSamples * kWritesPerSample + kWritesPerBlock;
+
+    void clear() { mSize = 0; }
+    int size() const { return mSize; }
+
+    // Writes must be pushed in non-decreasing cycle order. kCapacity covers
+    // the worst case of a chunk, so a write is never dropped.
+    void push(reSID::cycle_count cycle, reSID::reg8 address, reSID::reg8 value) {
+        assert(mSize < kCapacity && "more register writes than a chunk can hold");
+        mWrites[mSize++] = RegisterWrite{ cycle, address, value };
+    }
+
+    // Render n samples, applying the queued writes on the way. The samples
+    // are normalized floats, multiplied by gain.
+    int render(reSID::SID& sid, float* buf, int n, float gain) const {
+        int produced = 0;
+        reSID::cycle_count now = 0;
+        for (int k = 0; k < mSize; k++) {
+            const RegisterWrite& w = mWrites[k];
+            if (w.cycle > now && produced < n) {
+                reSID::cycle_count delta_t = w.cycle - now;
+                produced += sid.clock(delta_t, buf + produced, n - produced, gain);
+                // delta_t is left non-zero if the buffer filled up first.
+                now = w.cycle - delta_t;
+            }
+            sid.write(w.address, w.value);
+        }
+        if (produced < n) {
+            produced += sid.clock(buf + produced, n - produced, gain);
+        }
+        return produced;
+    }
+
+private:
+    RegisterWrite mWrites[kCapacity];
+    int mSize = 0;
+};
+
+} // namespace SIDOsc
@@ -0,0 +1,339 @@
+#include "RenderPool.hpp"
+#include "SIDDefs.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <new>
+#include <system_error>
+#include <thread>
+
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <mach/thread_policy.h>
+#include <pthread.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#endif
+
+namespace SIDOsc {
+
+static constexpr int kMaxWorkers = 8;
+static constexpr int kDefaultMaxWorkers = 4;
+// Entries per worker queue; a full queue sends the job to the next worker.
+static constexpr unsigned kQueueSize = 64;
+static constexpr std::size_t kCacheLine = 64;
+
+// ----------------------------------------------------------------------------
+// Wait-free single producer, single consumer ring. The head and the tail are
+// only ever written by one side each, and live on separate cache lines.
+// ----------------------------------------------------------------------------
+
+template <typename T, unsigned Capacity>
+class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    bool push(T value) {
+        const unsigned tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHead.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        mItems[tail & (Capacity - 1)] = value;
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& value) {
+        const unsigned head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = mItems[head & (Capacity - 1)];
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    alignas(kCacheLine) std::atomic<unsigned> mHead{ 0 };
+    alignas(kCacheLine) std::atomic<unsigned> mTail{ 0 };
+    T mItems[Capacity];
+};
+
+// ----------------------------------------------------------------------------
+// Counting semaphore. Posting does not take a lock on any of the platforms,
+// so DSP threads can wake a worker.
+// ----------------------------------------------------------------------------
+
+class Semaphore {
+public:
+#if defined(__APPLE__)
+    Semaphore() : mSemaphore(dispatch_semaphore_create(0)) {}
+    ~Semaphore() { dispatch_release(mSemaphore); }
+    void post() { dispatch_semaphore_signal(mSemaphore); }
+    void wait() { dispatch_semaphore_wait(mSemaphore, DISPATCH_TIME_FOREVER); }
+
+private:
+    dispatch_semaphore_t mSemaphore;
+#elif defined(_WIN32)
+    Semaphore() : mSemaphore(CreateSemaphore(nullptr, 0, LONG_MAX, nullptr)) {}
+    ~Semaphore() { CloseHandle(mSemaphore); }
+    void post() { ReleaseSemaphore(mSemaphore, 1, nullptr); }
+    void wait() { WaitForSingleObject(mSemaphore, INFINITE); }
+
+private:
+    HANDLE mSemaphore;
+#else
+    Semaphore() { sem_init(&mSemaphore, 0, 0); }
+    ~Semaphore() { sem_destroy(&mSemaphore); }
+    void post() { sem_post(&mSemaphore); }
+    void wait() {
+        while (sem_wait(&mSemaphore) != 0 && errno == EINTR) {
+        }
+    }
+
+private:
+    sem_t mSemaphore;
+#endif
+
+public:
+    Semaphore(const Semaphore&) = delete;
+    Semaphore& operator=(const Semaphore&) = delete;
+};
+
+// ----------------------------------------------------------------------------
+// Workers
+// ----------------------------------------------------------------------------
+
+struct Worker {
+    SpscQueue<RenderJob*, kQueueSize> inbox;
+    // Held by a DSP thread while it pushes. Under supernova several DSP
+    // threads submit at once; a thread that finds the flag taken moves on to
+    // the next worker instead of waiting, which keeps each queue single
+    // producer without blocking.
+    std::atomic_flag producer = ATOMIC_FLAG_INIT;
+    Semaphore wake;
+    std::thread thread;
+};
+
+// Scheduling of the DSP thread that requested the pool, for the workers.
+struct PoolRequest {
+    double blockDuration;
+    int policy;
+    int priority;
+};
+
+enum PoolState { kIdle, kStarting, kRunning };
+
+// Allocated by the non real-time thread when the pool starts, and published
+// through gNumWorkers. Never a static object, so that a server that does not
+// call PluginUnload is not stopped by joinable threads at exit.
+static Worker* gWorkers = nullptr;
+static std::atomic<int> gNumWorkers{ 0 };
+static int gPlannedWorkers = 0;
+static std::atomic<int> gPoolState{ kIdle };
+static PoolRequest gPoolRequest;
+static std::atomic<bool> gStopping{ false };
+static std::atomic<unsigned> gNextWorker{ 0 };
+static std::atomic<uint64_t> gMisses{ 0 };
+
+static bool runIfQueued(RenderJob* job) {
+    int expected = RenderJob::kQueued;
+    if (!job->state.compare_exchange_strong(expected, RenderJob::kRunning,
+                                            std::memory_order_acquire, std::memory_order_relaxed)) {
+        return false;
+    }
+    job->run(job);
+    job->state.store(RenderJob::kDone, std::memory_order_release);
+    return true;
+}
+
+// Entries may refer to a job that its owner has run or cancelled in the
+// meantime, or already submitted again; runIfQueued() only runs jobs that
+// are still waiting, so each submission runs exactly once.
+static void workerLoop(Worker* worker) {
+    for (;;) {
+        worker->wake.wait();
+        if (gStopping.load(std::memory_order_acquire)) {
+            return;
+        }
+        RenderJob* job;
+        while (worker->inbox.pop(job)) {
+            runIfQueued(job);
+            job->queued.fetch_sub(1, std::memory_order_release);
+        }
+    }
+}
+
+// Workers run in the real-time class, so that they are not preempted by
+// ordinary threads while a DSP thread counts on their output: on macOS as
+// time constraint threads with the block period, on Windows at time critical
+// priority, and elsewhere with the policy and priority of the DSP thread.
+static bool setRealtimePriority(std::thread& thread, const PoolRequest& request) {
+#if defined(__APPLE__)
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    const double ticksPerSecond = 1e9 * timebase.denom / timebase.numer;
+    thread_time_constraint_policy_data_t policy;
+    policy.period = static_cast<uint32_t>(request.blockDuration * ticksPerSecond);
+    policy.computation = policy.period / 2;
+    policy.constraint = policy.period;
+    policy.preemptible = 1;
+    return thread_policy_set(pthread_mach_thread_np(thread.native_handle()), THREAD_TIME_CONSTRAINT_POLICY,
+                             reinterpret_cast<thread_policy_t>(&policy), THREAD_TIME_CONSTRAINT_POLICY_COUNT)
+        == KERN_SUCCESS;
+#elif defined(_WIN32)
+    return SetThreadPriority(thread.native_handle(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#else
+    if (request.policy != SCHED_FIFO && request.policy != SCHED_RR) {
+        // The DSP thread is not real-time either; the workers match it as is.
+        return true;
+    }
+    sched_param param{};
+    param.sched_priority = request.priority;
+    return pthread_setschedparam(thread.native_handle(), request.policy, &param) == 0;
+#endif
+}
+
+// Stage 2 of the command queued by requestRenderPool(), on the non
+// real-time thread.
+static bool startWorkers(World*, void* data) {
+    const PoolRequest* request = static_cast<const PoolRequest*>(data);
+    Worker* workers = new (std::nothrow) Worker[gPlannedWorkers];
+    int started = 0;
+    bool realtime = true;
+    if (workers) {
+        gStopping.store(false, std::memory_order_release);
+        for (; started < gPlannedWorkers; started++) {
+            try {
+                workers[started].thread = std::thread(workerLoop, &workers[started]);
+            } catch (const std::system_error&) {
+                break;
+            }
+            realtime &= setRealtimePriority(workers[started].thread, *request);
+        }
+    }
+    if (started == 0) {
+        Print("SIDBank: could not start the render workers, rendering on the DSP thread\n");
+        delete[] workers;
+        return false;
+    }
+    if (!realtime) {
+        Print("SIDBank: could not give the render workers real-time priority\n");
+    }
+    gWorkers = workers;
+    gNumWorkers.store(started, std::memory_order_release);
+    gPoolState.store(kRunning, std::memory_order_release);
+    return false;
+}
+
+void configureRenderPool() {
+    int n;
+    if (const char* env = std::getenv("SIDOSC_WORKERS")) {
+        n = std::min(std::max(std::atoi(env), 0), kMaxWorkers);
+    } else {
+        // Leave half of the cores to the DSP threads.
+        const int cores = static_cast<int>(std::thread::hardware_concurrency());
+        n = std::min(cores / 2, kDefaultMaxWorkers);
+    }
+    gPlannedWorkers = n;
+}
+
+int plannedRenderWorkers() {
+    return gPlannedWorkers;
+}
+
+void requestRenderPool(World* world) {
+    int expected = kIdle;
+    if (gPlannedWorkers == 0
+        || !gPoolState.compare_exchange_strong(expected, kStarting, std::memory_order_acq_rel)) {
+        return;
+    }
+    gPoolRequest.blockDuration = world->mBufLength / world->mSampleRate;
+#if !defined(__APPLE__) && !defined(_WIN32)
+    sched_param param;
+    if (pthread_getschedparam(pthread_self(), &gPoolRequest.policy, &param) == 0) {
+        gPoolRequest.priority = param.sched_priority;
+    } else {
+        gPoolRequest.policy = SCHED_OTHER;
+    }
+#endif
+    DoAsynchronousCommand(world, nullptr, "sidbank_workers", &gPoolRequest, startWorkers, nullptr, nullptr, nullptr,
+                          0, nullptr);
+}
+
+void stopRenderPool() {
+    const int n = gNumWorkers.exchange(0, std::memory_order_acq_rel);
+    if (gWorkers) {
+        gStopping.store(true, std::memory_order_release);
+        for (int i = 0; i < n; i++) {
+            gWorkers[i].wake.post();
+        }
+        for (int i = 0; i < n; i++) {
+            gWorkers[i].thread.join();
+        }
+        delete[] gWorkers;
+        gWorkers = nullptr;
+    }
+    gPoolState.store(kIdle, std::memory_order_release);
+}
+
+int numRenderWorkers() {
+    return gNumWorkers.load(std::memory_order_acquire);
+}
+
+// If every queue is full or busy, the job stays queued and is run by
+// completeRenderJob() on the owner's thread.
+bool submitRenderJob(RenderJob* job) {
+    job->state.store(RenderJob::kQueued, std::memory_order_release);
+
+    const int n = gNumWorkers.load(std::memory_order_acquire);
+    const unsigned first = gNextWorker.fetch_add(1, std::memory_order_relaxed);
+    for (int k = 0; k < n; k++) {
+        Worker& worker = gWorkers[(first + k) % n];
+        if (worker.producer.test_and_set(std::memory_order_acquire)) {
+            continue;
+        }
+        job->queued.fetch_add(1, std::memory_order_relaxed);
+        const bool pushed = worker.inbox.push(job);
+        worker.producer.clear(std::memory_order_release);
+        if (pushed) {
+            worker.wake.post();
+            return true;
+        }
+        job->queued.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return false;
+}
+
+bool completeRenderJob(RenderJob* job) {
+    if (runIfQueued(job) || job->state.load(std::memory_order_acquire) == RenderJob::kDone) {
+        return true;
+    }
+    gMisses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void cancelRenderJob(RenderJob* job) {
+    int expected = RenderJob::kQueued;
+    job->state.compare_exchange_strong(expected, RenderJob::kDone, std::memory_order_acq_rel);
+}
+
+// A worker drops its queue entry only after it has run the job, so no entry
+// also means the job is not running.
+bool renderJobIdle(const RenderJob* job) {
+    return job->queued.load(std::memory_order_acquire) == 0
+        && job->state.load(std::memory_order_acquire) != RenderJob::kRunning;
+}
+
+uint64_t renderMisses() {
+    return gMisses.load(std::memory_order_relaxed);
+}
+
+} // namespace SIDOsc
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+struct World;
+
+namespace SIDOsc {
+
+// A unit of rendering work handed from a DSP thread to the render workers.
+//
+// The submitting node owns the job and must not touch the state the job
+// renders from between submitRenderJob() and a completeRenderJob() that
+// returns true. The job memory has to outlive renderJobIdle() turning true.
+struct RenderJob {
+    enum State { kDone, kQueued, kRunning };
+
+    RenderJob() = default;
+    RenderJob(const RenderJob&) = delete;
+    RenderJob& operator=(const RenderJob&) = delete;
+
+    void (*run)(RenderJob* job) = nullptr;
+
+    std::atomic<int> state{ kDone };
+    // Worker queue entries that still point at this job.
+    std::atomic<int> queued{ 0 };
+};
+
+// Reads the number of workers the pool is to run, from the SIDOSC_WORKERS
+// environment variable if set, and from the number of cores otherwise.
+// Called from PluginLoad; no threads are started yet.
+void configureRenderPool();
+int plannedRenderWorkers();
+
+// Starts the workers on first use. Called from a DSP thread: the threads
+// are started by an asynchronous command on the non real-time thread, and
+// are given real-time priority, matching the calling thread where the
+// platform allows. Until they run, numRenderWorkers() is 0 and submitted jobs
+// run in completeRenderJob(). Real-time safe.
+void requestRenderPool(World* world);
+
+// Joins the workers. Called from PluginUnload, once no nodes are left.
+void stopRenderPool();
+
+int numRenderWorkers();
+
+// Hands the job to a worker without blocking. Returns false if no worker
+// could take it; the job then runs in completeRenderJob() instead.
+// Real-time safe, and safe to call from several DSP threads at once.
+bool submitRenderJob(RenderJob* job);
+
+// Finishes a submitted job without ever blocking. A job no worker has
+// started yet is run on the calling thread, so that slow workers only cost
+// time. Returns false, and counts a miss, if a worker is still rendering
+// the job; the owner then leaves it alone until a later call returns true.
+// Real-time safe.
+bool completeRenderJob(RenderJob* job);
+
+// Withdraws a job no worker has started yet. Real-time safe.
+void cancelRenderJob(RenderJob* job);
+
+// True once no worker runs the job or holds a queue entry for it, so that
+// its memory can be freed.
+bool renderJobIdle(const RenderJob* job);
+
+// completeRenderJob() calls that found their job still rendering.
+uint64_t renderMisses();
+
+} // namespace SIDOsc
@@ -0,0 +1,644 @@
+#include "SIDBank.hpp"
+#include "SIDDefs.hpp"
+#include "wave.h"
+#include "envelope.h"
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <thread>
+
+using namespace reSID;
+
+extern InterfaceTable* ft;
+
+namespace SIDOsc {
+
+static constexpr double kAccResolution = 16777216.0; // = 2^24
+static constexpr int    kFreqRegMax   = 0xFFFF;
+static constexpr int    kFixpShift    = 16;
+static constexpr int    kFixpMask     = (1 << kFixpShift) - 1;
+// Full scale of one chip's three voices: 3 * 2048 * 255.
+static constexpr float  kBankNorm     = 1566720.0f;
+
+// Input indices; the per-chip frequencies follow kInFirstFreq.
+static constexpr int kInGain      = 0;
+static constexpr int kInWaveform  = 1;
+static constexpr int kInDacType   = 2;
+static constexpr int kInGate      = 3;
+static constexpr int kInThreaded  = 4;
+static constexpr int kInFirstFreq = 5;
+
+// Partitions are kept apart by this much, so that two workers never write
+// to the same cache line.
+static constexpr std::size_t kCacheLine = 64;
+
+static inline std::size_t padToCacheLine(std::size_t size) {
+    return (size + kCacheLine - 1) / kCacheLine * kCacheLine;
+}
+
+// Access to the protected envelope tables of reSID.
+struct EnvelopeTables : public EnvelopeGenerator {
+    using EnvelopeGenerator::rate_counter_period;
+    using EnvelopeGenerator::sustain_level;
+    using EnvelopeGenerator::model_dac;
+};
+
+static inline int sourceLane(int voice, int chip, int stride) {
+    return ((voice + 2) % 3) * stride + chip;
+}
+
+static inline int noiseOutput(int32_t shiftRegister) {
+    return
+        ((shiftRegister & 0x100000) >> 9) |
+        ((shiftRegister & 0x040000) >> 8) |
+        ((shiftRegister & 0x004000) >> 5) |
+        ((shiftRegister & 0x000800) >> 3) |
+        ((shiftRegister & 0x000200) >> 2) |
+        ((shiftRegister & 0x000020) << 1) |
+        ((shiftRegister & 0x000004) << 3) |
+        ((shiftRegister & 0x000001) << 4);
+}
+
+// ----------------------------------------------------------------------------
+// ChipBank
+// ----------------------------------------------------------------------------
+
+std::size_t ChipBank::memorySize(int nChips) {
+    const int stride = (nChips + kLaneAlign - 1) / kLaneAlign * kLaneAlign;
+    return (static_cast<std::size_t>(kNumLaneArrays) * 3 + 1) * stride * sizeof(int32_t);
+}
+
+void ChipBank::init(void* memory, int nChips) {
+    WaveformGenerator::class_init();
+
+    mNumChips = nChips;
+    mStride = (nChips + kLaneAlign - 1) / kLaneAlign * kLaneAlign;
+    mNumLanes = 3 * mStride;
+    std::memset(memory, 0, memorySize(nChips));
+
+    int32_t* p = static_cast<int32_t*>(memory);
+    int32_t** const arrays[kNumLaneArrays] = {
+        &mAccumulator, &mFreq, &mPW, &mTest, &mSync, &mWaveform, &mRingMsbMask,
+        &mNoNoise, &mNoPulse, &mPulseOutput, &mShiftRegister, &mMsbRising, &mNoiseShifts,
+        &mRateCounter, &mRatePeriod, &mEnvelopeStep, &mExponentialCounter,
+        &mExponentialCounterPeriod, &mEnvelopeCounter, &mEnvelopeState, &mHoldZero,
+        &mGate, &mAttack, &mDecay, &mSustain, &mRelease
+    };
+    for (int a = 0; a < kNumLaneArrays; a++) {
+        *arrays[a] = p;
+        p += mNumLanes;
+    }
+    mChipModel = p;
+
+    // Power-up state, as WaveformGenerator::reset() and EnvelopeGenerator::reset().
+    for (int i = 0; i < mNumLanes; i++) {
+        mAccumulator[i] = 0x555555;
+        mShiftRegister[i] = 0x7ffffe;
+        mNoNoise[i] = 0xfff;
+        mNoPulse[i] = 0xfff;
+        mPulseOutput[i] = 0xfff;
+        mExponentialCounterPeriod[i] = 1;
+        mEnvelopeState[i] = RELEASE;
+        mRatePeriod[i] = EnvelopeTables::rate_counter_period[0];
+        mHoldZero[i] = 1;
+    }
+}
+
+void ChipBank::setChipModel(int chip, chip_model model) {
+    mChipModel[chip] = model;
+}
+
+void ChipBank::writeFreq(int chip, int voice, reg16 freq) {
+    mFreq[voice * mStride + chip] = freq & 0xffff;
+}
+
+void ChipBank::writePW(int chip, int voice, reg12 pw) {
+    mPW[voice * mStride + chip] = pw & 0xfff;
+}
+
+// Waveform and envelope halves of WaveformGenerator::writeCONTROL_REG() and
+// EnvelopeGenerator::writeCONTROL_REG().
+void ChipBank::writeControl(int chip, int voice, reg8 control) {
+    const int i = voice * mStride + chip;
+
+    const int32_t testPrev = mTest[i];
+    const int32_t waveform = (control >> 4) & 0x0f;
+    mWaveform[i] = waveform;
+    mTest[i] = (control & 0x08) ? 1 : 0;
+    mSync[i] = (control & 0x02) ? 1 : 0;
+    mRingMsbMask[i] = ((~control >> 5) & (control >> 2) & 0x1) << 23;
+    mNoNoise[i] = (waveform & 0x8) ? 0x000 : 0xfff;
+    mNoPulse[i] = (waveform & 0x4) ? 0x000 : 0xfff;
+
+    if (!testPrev && mTest[i]) {
+        // The shift register is filled with ones while the test bit is held;
+        // the reset delay is not modelled.
+        mAccumulator[i] = 0;
+        mShiftRegister[i] = 0x7fffff;
+        mPulseOutput[i] = 0xfff;
+    } else if (testPrev && !mTest[i]) {
+        const int32_t bit0 = (~mShiftRegister[i] >> 17) & 0x1;
+        mShiftRegister[i] = ((mShiftRegister[i] << 1) | bit0) & 0x7fffff;
+    }
+
+    const int32_t gateNext = control & 0x01;
+    if (!mGate[i] && gateNext) {
+        mEnvelopeState[i] = ATTACK;
+        mRatePeriod[i] = EnvelopeTables::rate_counter_period[mAttack[i]];
+        mHoldZero[i] = 0;
+    } else if (mGate[i] && !gateNext) {
+        mEnvelopeState[i] = RELEASE;
+        mRatePeriod[i] = EnvelopeTables::rate_counter_period[mRelease[i]];
+    }
+    mGate[i] = gateNext;
+}
+
+void ChipBank::writeAttackDecay(int chip, int voice, reg8 attackDecay) {
+    const int i = voice * mStride + chip;
+    mAttack[i] = (attackDecay >> 4) & 0x0f;
+    mDecay[i] = attackDecay & 0x0f;
+    if (mEnvelopeState[i] == ATTACK) {
+        mRatePeriod[i] = EnvelopeTables::rate_counter_period[mAttack[i]];
+    } else if (mEnvelopeState[i] == DECAY_SUSTAIN) {
+        mRatePeriod[i] = EnvelopeTables::rate_counter_period[mDecay[i]];
+    }
+}
+
+void ChipBank::writeSustainRelease(int chip, int voice, reg8 sustainRelease) {
+    const int i = voice * mStride + chip;
+    mSustain[i] = (sustainRelease >> 4) & 0x0f;
+    mRelease[i] = sustainRelease & 0x0f;
+    if (mEnvelopeState[i] == RELEASE) {
+        mRatePeriod[i] = EnvelopeTables::rate_counter_period[mRelease[i]];
+    }
+}
+
+// Accumulators, as WaveformGenerator::clock(delta_t). The noise register is
+// shifted once for each 0 -> 1 transition of accumulator bit 19; the number
+// of shifts is returned per lane.
+static int32_t clockAccumulators(int n, cycle_count deltaT,
+                                 int32_t* __restrict acc, const int32_t* __restrict freq,
+                                 const int32_t* __restrict pw, const int32_t* __restrict test,
+                                 int32_t* __restrict pulse, int32_t* __restrict msbRising,
+                                 int32_t* __restrict noiseShifts) {
+    int32_t anyShift = 0;
+    for (int i = 0; i < n; i++) {
+        const int32_t a = acc[i];
+        const int32_t delta = deltaT * freq[i];
+        const int32_t next = (a + delta) & 0xffffff;
+        const int32_t shifts = ((a + delta + 0x80000) >> 20) - ((a + 0x80000) >> 20);
+        const bool running = test[i] == 0;
+
+        acc[i] = running ? next : a;
+        msbRising[i] = running ? ((~a & next) >> 23) & 0x1 : 0;
+        noiseShifts[i] = running ? shifts : 0;
+        pulse[i] = running ? -((next >> 12) >= pw[i]) & 0xfff : 0xfff;
+        anyShift |= noiseShifts[i];
+    }
+    return anyShift;
+}
+
+// Envelope rate counters, as EnvelopeGenerator::clock(delta_t). Lanes due for
+// an envelope step are flagged and left unchanged.
+static int32_t clockRateCounters(int n, cycle_count deltaT,
+                                 int32_t* __restrict rateCounter, const int32_t* __restrict ratePeriod,
+                                 int32_t* __restrict envelopeStep) {
+    int32_t anyStep = 0;
+    for (int i = 0; i < n; i++) {
+        int32_t rateStep = ratePeriod[i] - rateCounter[i];
+        rateStep += (rateStep <= 0) ? 0x7fff : 0;
+        const int32_t stepping = deltaT >= rateStep;
+        int32_t counter = rateCounter[i] + deltaT;
+        counter = (counter & 0x8000) ? ((counter + 1) & 0x7fff) : counter;
+
+        rateCounter[i] = stepping ? rateCounter[i] : counter;
+        envelopeStep[i] = stepping;
+        anyStep |= stepping;
+    }
+    return anyStep;
+}
+
+void ChipBank::clock(cycle_count deltaT) {
+    const int n = mNumLanes;
+
+    if (clockAccumulators(n, deltaT, mAccumulator, mFreq, mPW, mTest,
+                          mPulseOutput, mMsbRising, mNoiseShifts)) {
+        for (int i = 0; i < n; i++) {
+            if (mNoiseShifts[i]) {
+                shiftNoise(i, mNoiseShifts[i]);
+            }
+        }
+    }
+
+    synchronize();
+
+    if (clockRateCounters(n, deltaT, mRateCounter, mRatePeriod, mEnvelopeStep)) {
+        for (int i = 0; i < n; i++) {
+            if (mEnvelopeStep[i]) {
+                stepEnvelope(i, deltaT);
+            }
+        }
+    }
+}
+
+void ChipBank::shiftNoise(int lane, int count) {
+    int32_t shiftRegister = mShiftRegister[lane];
+    for (int k = 0; k < count; k++) {
+        const int32_t bit0 = ((shiftRegister >> 22) ^ (shiftRegister >> 17)) & 0x1;
+        shiftRegister = ((shiftRegister << 1) | bit0) & 0x7fffff;
+    }
+    mShiftRegister[lane] = shiftRegister;
+}
+
+// Hard sync of one voice row, as WaveformGenerator::synchronize().
+static void synchronizeRow(int n, const int32_t* __restrict msb, const int32_t* __restrict msbSource,
+                           const int32_t* __restrict sync, const int32_t* __restrict syncDest,
+                           int32_t* __restrict accDest) {
+    for (int c = 0; c < n; c++) {
+        const bool reset = msb[c] && syncDest[c] && !(sync[c] && msbSource[c]);
+        accDest[c] = reset ? 0 : accDest[c];
+    }
+}
+
+// The sync conditions depend only on the MSB flags, so the three voices can
+// be processed in any order.
+void ChipBank::synchronize() {
+    for (int v = 0; v < 3; v++) {
+        const int source = ((v + 2) % 3) * mStride;
+        const int dest = ((v + 1) % 3) * mStride;
+        synchronizeRow(mStride, mMsbRising + v * mStride, mMsbRising + source,
+                       mSync + v * mStride, mSync + dest, mAccumulator + dest);
+    }
+}
+
+// Scalar port of the stepping part of EnvelopeGenerator::clock(delta_t).
+void ChipBank::stepEnvelope(int i, cycle_count deltaT) {
+    int rateStep = mRatePeriod[i] - mRateCounter[i];
+    if (rateStep <= 0) {
+        rateStep += 0x7fff;
+    }
+
+    while (deltaT) {
+        if (deltaT < rateStep) {
+            mRateCounter[i] += deltaT;
+            if (mRateCounter[i] & 0x8000) {
+                mRateCounter[i] = (mRateCounter[i] + 1) & 0x7fff;
+            }
+            return;
+        }
+
+        mRateCounter[i] = 0;
+        deltaT -= rateStep;
+
+        if (mEnvelopeState[i] == ATTACK || ++mExponentialCounter[i] == mExponentialCounterPeriod[i]) {
+            mExponentialCounter[i] = 0;
+
+            if (mHoldZero[i]) {
+                rateStep = mRatePeriod[i];
+                continue;
+            }
+
+            switch (mEnvelopeState[i]) {
+            case ATTACK:
+                mEnvelopeCounter[i] = (mEnvelopeCounter[i] + 1) & 0xff;
+                if (mEnvelopeCounter[i] == 0xff) {
+                    mEnvelopeState[i] = DECAY_SUSTAIN;
+                    mRatePeriod[i] = EnvelopeTables::rate_counter_period[mDecay[i]];
+                }
+                break;
+            case DECAY_SUSTAIN:
+                if (mEnvelopeCounter[i] == static_cast<int32_t>(EnvelopeTables::sustain_level[mSustain[i]])) {
+                    return;
+                }
+                --mEnvelopeCounter[i];
+                break;
+            case RELEASE:
+                mEnvelopeCounter[i] = (mEnvelopeCounter[i] - 1) & 0xff;
+                break;
+            }
+
+            // Exponential counter period, as EnvelopeGenerator::set_exponential_counter().
+            switch (mEnvelopeCounter[i]) {
+            case 0xff: mExponentialCounterPeriod[i] = 1; break;
+            case 0x5d: mExponentialCounterPeriod[i] = 2; break;
+            case 0x36: mExponentialCounterPeriod[i] = 4; break;
+            case 0x1a: mExponentialCounterPeriod[i] = 8; break;
+            case 0x0e: mExponentialCounterPeriod[i] = 16; break;
+            case 0x06: mExponentialCounterPeriod[i] = 30; break;
+            case 0x00:
+                mExponentialCounterPeriod[i] = 1;
+                mHoldZero[i] = 1;
+                break;
+            }
+        }
+
+        rateStep = mRatePeriod[i];
+    }
+}
+
+// Waveform table lookup, as WaveformGenerator::set_waveform_output(), followed
+// by the multiplying DAC of Voice::output().
+int ChipBank::voiceOutput(int voice, int chip) const {
+    const int i = voice * mStride + chip;
+    const int model = mChipModel[chip];
+    const int waveform = mWaveform[i];
+
+    int waveformOutput = 0;
+    if (waveform) {
+        const int ix = (mAccumulator[i] ^ (~mAccumulator[sourceLane(voice, chip, mStride)] & mRingMsbMask[i])) >> 12;
+        waveformOutput = WaveformGenerator::model_wave[model][waveform & 0x7][ix]
+            & (mNoPulse[i] | mPulseOutput[i])
+            & (mNoNoise[i] | noiseOutput(mShiftRegister[i]));
+        if ((waveform & 0xc) == 0xc) {
+            waveformOutput = (model == MOS6581) ?
+                noise_pulse6581(waveformOutput) : noise_pulse8580(waveformOutput);
+        }
+    }
+
+    // The DAC output is centred at mid-scale on both models. The DC offset of
+    // the 6581 waveform D/A (Voice::wave_zero) is left out, since there is no
+    // external filter to remove it.
+    return (WaveformGenerator::model_dac[model][waveformOutput] - 0x800)
+        * EnvelopeTables::model_dac[model][mEnvelopeCounter[i]];
+}
+
+int ChipBank::output(int chip) const {
+    return voiceOutput(0, chip) + voiceOutput(1, chip) + voiceOutput(2, chip);
+}
+
+// ----------------------------------------------------------------------------
+// SIDBank
+// ----------------------------------------------------------------------------
+
+SIDBank::SIDBank()
+    : mMemory(nullptr)
+    , mPartitions(nullptr)
+    , mNumPartitions(0)
+    , mFreqCache(nullptr)
+{
+    const int nChips = numOutputs();
+    if (nChips < 1 || numInputs() - kInFirstFreq != nChips) {
+        Print("SIDBank: expected one frequency input per output\n");
+        mCalcFunc = ft->fClearUnitOutputs;
+        ClearUnitOutputs(this, 1);
+        return;
+    }
+
+    bool threaded = in0(kInThreaded) > 0.5f;
+    if (threaded && plannedRenderWorkers() == 0) {
+        Print("SIDBank: no render workers, rendering on the DSP thread\n");
+        threaded = false;
+    }
+    if (threaded) {
+        requestRenderPool(mWorld);
+    }
+
+    // Partitions of whole lane groups, at most one per worker.
+    int chipsPerPartition = nChips;
+    if (threaded) {
+        const int groups = (nChips + ChipBank::kLaneAlign - 1) / ChipBank::kLaneAlign;
+        const int groupsPerPartition = (groups + plannedRenderWorkers() - 1) / plannedRenderWorkers();
+        chipsPerPartition = groupsPerPartition * ChipBank::kLaneAlign;
+    }
+    const int nPartitions = (nChips + chipsPerPartition - 1) / chipsPerPartition;
+
+    std::size_t memorySize = padToCacheLine(sizeof(MemoryHeader)) + padToCacheLine(nPartitions * sizeof(Partition)) + padToCacheLine(nChips * sizeof(float));
+    for (int p = 0; p < nPartitions; p++) {
+        const int chips = std::min(chipsPerPartition, nChips - p * chipsPerPartition);
+        memorySize += padToCacheLine(ChipBank::memorySize(chips));
+        if (threaded) {
+            memorySize += 2 * (padToCacheLine(chips * sizeof(float*)) + padToCacheLine(chips * bufferSize() * sizeof(float)));
+        }
+    }
+    mMemory = RTAlloc(mWorld, memorySize);
+    if (!mMemory) {
+        Print("SIDBank: out of real-time memory\n");
+        mCalcFunc = ft->fClearUnitOutputs;
+        ClearUnitOutputs(this, 1);
+        return;
+    }
+
+    char* memory = static_cast<char*>(mMemory);
+    MemoryHeader* header = reinterpret_cast<MemoryHeader*>(memory);
+    memory += padToCacheLine(sizeof(MemoryHeader));
+    mPartitions = reinterpret_cast<Partition*>(memory);
+    header->partitions = mPartitions;
+    header->numPartitions = 0;
+    memory += padToCacheLine(nPartitions * sizeof(Partition));
+    mFreqCache = reinterpret_cast<float*>(memory);
+    memory += padToCacheLine(nChips * sizeof(float));
+
+    const cycle_count cyclesPerSample = static_cast<cycle_count>(kClockFreq / sampleRate() * (1 << kFixpShift) + 0.5);
+    const chip_model model = (static_cast<int>(in0(kInDacType)) == 1) ? MOS8580 : MOS6581;
+    for (int p = 0; p < nPartitions; p++) {
+        Partition* partition = new (&mPartitions[p]) Partition();
+        mNumPartitions = p + 1;
+        header->numPartitions = mNumPartitions;
+        partition->run = render;
+        partition->firstChip = p * chipsPerPartition;
+        partition->nSamples = 0;
+        partition->lastRows = nullptr;
+        partition->lastSamples = 0;
+        partition->scale = 0.0f;
+        partition->cyclesPerSample = cyclesPerSample;
+        partition->sampleOffset = 0;
+        partition->numControls = 0;
+        partition->numPending = 0;
+        partition->prevControlReg = 0xFF;
+
+        const int chips = std::min(chipsPerPartition, nChips - partition->firstChip);
+        partition->bank.init(memory, chips);
+        memory += padToCacheLine(ChipBank::memorySize(chips));
+        if (threaded) {
+            float*** const buffers[2] = { &partition->rows, &partition->lastRows };
+            for (float*** rows : buffers) {
+                *rows = reinterpret_cast<float**>(memory);
+                memory += padToCacheLine(chips * sizeof(float*));
+                for (int c = 0; c < chips; c++) {
+                    (*rows)[c] = reinterpret_cast<float*>(memory) + c * bufferSize();
+                }
+                memory += padToCacheLine(chips * bufferSize() * sizeof(float));
+            }
+        } else {
+            partition->rows = mOutBuf + partition->firstChip;
+        }
+
+        for (int c = 0; c < chips; c++) {
+            partition->bank.setChipModel(c, model);
+            // Same defaults as SIDOsc: attack 2 ms, full sustain, release 6 ms; 50% pulse width.
+            for (int v = 0; v < 3; v++) {
+                partition->bank.writePW(c, v, 0x800);
+                partition->bank.writeAttackDecay(c, v, 0x00);
+                partition->bank.writeSustainRelease(c, v, 0xF0);
+            }
+        }
+    }
+    for (int c = 0; c < nChips; c++) {
+        mFreqCache[c] = -1.0f;
+    }
+
+    if (threaded) {
+        // Nothing is rendered yet; the first block is submitted by the first
+        // calc call.
+        mCalcFunc = make_calc_function<SIDBank, &SIDBank::nextThreaded>();
+        ClearUnitOutputs(this, 1);
+    } else {
+        mCalcFunc = make_calc_function<SIDBank, &SIDBank::next>();
+        next(1);
+    }
+}
+
+// The destructor runs on the DSP thread, so it does not wait for a worker
+// that is still rendering: the memory is then freed by an asynchronous
+// command, once the workers are done with it.
+SIDBank::~SIDBank() {
+    if (!mMemory) {
+        return;
+    }
+    bool idle = true;
+    for (int p = 0; p < mNumPartitions; p++) {
+        cancelRenderJob(&mPartitions[p]);
+        idle = idle && renderJobIdle(&mPartitions[p]);
+    }
+    if (idle) {
+        freeMemory(mWorld, mMemory);
+    } else {
+        DoAsynchronousCommand(mWorld, nullptr, "sidbank_release", mMemory, waitForWorkers, nullptr, nullptr,
+                              freeMemory, 0, nullptr);
+    }
+}
+
+// Stage 2 of the release command, on the non real-time thread. A job only
+// ever runs for the length of one block.
+bool SIDBank::waitForWorkers(World*, void* memory) {
+    const MemoryHeader* header = static_cast<const MemoryHeader*>(memory);
+    for (int p = 0; p < header->numPartitions; p++) {
+        while (!renderJobIdle(&header->partitions[p])) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+    return true;
+}
+
+// Real-time thread, as the cleanup of the release command or from the
+// destructor.
+void SIDBank::freeMemory(World* world, void* memory) {
+    const MemoryHeader* header = static_cast<const MemoryHeader*>(memory);
+    for (int p = 0; p < header->numPartitions; p++) {
+        header->partitions[p].~Partition();
+    }
+    RTFree(world, memory);
+}
+
+// Keeps the control register value of this block for the partition's next
+// block, unless it is the one kept last.
+void SIDBank::queueControl(Partition& partition) {
+    const int waveformType = static_cast<int>(in0(kInWaveform));
+    const bool currentGate = (in0(kInGate) > 0.5f);
+    const reg8 control = static_cast<reg8>((waveformType << 4) | (currentGate ? 0x01 : 0x00));
+
+    if (control == partition.prevControlReg) {
+        return;
+    }
+    if (partition.numPending == kMaxControls) {
+        partition.numPending--;
+    }
+    partition.pendingControls[partition.numPending++] = control;
+    partition.prevControlReg = control;
+}
+
+// Register writes of a block, made while no worker is rendering the
+// partition.
+void SIDBank::writeInputs(Partition& partition, int nSamples) {
+    queueControl(partition);
+    std::copy(partition.pendingControls, partition.pendingControls + partition.numPending, partition.controls);
+    partition.numControls = partition.numPending;
+    partition.numPending = 0;
+    partition.nSamples = nSamples;
+    partition.scale = in0(kInGain) / kBankNorm;
+
+    // Frequencies are written once per block.
+    for (int c = 0; c < partition.bank.numChips(); c++) {
+        const int chip = partition.firstChip + c;
+        const float freq = in0(kInFirstFreq + chip);
+        if (freq == mFreqCache[chip]) {
+            continue;
+        }
+        mFreqCache[chip] = freq;
+        reg16 value = 0;
+        if (freq > 0.0f) {
+            value = std::min(static_cast<unsigned int>((freq * kAccResolution) / kClockFreq), static_cast<unsigned int>(kFreqRegMax));
+        }
+        for (int v = 0; v < 3; v++) {
+            partition.bank.writeFreq(c, v, value);
+        }
+    }
+}
+
+void SIDBank::render(RenderJob* job) {
+    Partition* partition = static_cast<Partition*>(job);
+    ChipBank& bank = partition->bank;
+    const int nChips = bank.numChips();
+    const float scale = partition->scale;
+    const int nSamples = partition->nSamples;
+    const int numControls = partition->numControls;
+    int nextControl = 0;
+
+    for (int i = 0; i < nSamples; i++) {
+        while (nextControl < numControls && nextControl * nSamples <= i * numControls) {
+            for (int c = 0; c < nChips; c++) {
+                for (int v = 0; v < 3; v++) {
+                    bank.writeControl(c, v, partition->controls[nextControl]);
+                }
+            }
+            nextControl++;
+        }
+
+        // Delta clocking picking the nearest cycle, as SID::clock_fast().
+        const cycle_count nextSampleOffset = partition->sampleOffset + partition->cyclesPerSample + (1 << (kFixpShift - 1));
+        bank.clock(nextSampleOffset >> kFixpShift);
+        partition->sampleOffset = (nextSampleOffset & kFixpMask) - (1 << (kFixpShift - 1));
+
+        for (int c = 0; c < nChips; c++) {
+            partition->rows[c][i] = bank.output(c) * scale;
+        }
+    }
+}
+
+void SIDBank::next(int nSamples) {
+    writeInputs(mPartitions[0], nSamples);
+    render(&mPartitions[0]);
+}
+
+// Outputs the block the workers rendered since the previous calc call, then
+// writes this block's inputs and submits the next block. A partition no
+// worker has started is rendered here; one a worker is still rendering
+// repeats its previous block and keeps this block's control register value,
+// and is submitted again once it is done.
+void SIDBank::nextThreaded(int nSamples) {
+    for (int p = 0; p < mNumPartitions; p++) {
+        Partition& partition = mPartitions[p];
+        const bool ready = completeRenderJob(&partition);
+        if (ready) {
+            std::swap(partition.rows, partition.lastRows);
+            partition.lastSamples = partition.nSamples;
+        }
+        for (int c = 0; c < partition.bank.numChips(); c++) {
+            float* output = out(partition.firstChip + c);
+            if (partition.lastSamples == nSamples) {
+                std::memcpy(output, partition.lastRows[c], nSamples * sizeof(float));
+            } else {
+                std::fill(output, output + nSamples, 0.0f);
+            }
+        }
+        if (ready) {
+            writeInputs(partition, nSamples);
+            submitRenderJob(&partition);
+        } else {
+            queueControl(partition);
+        }
+    }
+}
+
+} // namespace SIDOsc
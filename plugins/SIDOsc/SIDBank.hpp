@@ -0,0 +1,166 @@
+#pragma once
+
+#include "SC_PlugIn.hpp"
+#include "RenderPool.hpp"
+#include "siddefs.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace SIDOsc {
+
+// Oscillator and envelope state for a bank of SID chips, stored as
+// struct-of-arrays. Lane v * stride + c holds voice v of chip c, so that each
+// voice row is contiguous and the per-cycle arithmetic runs over plain int32
+// arrays which the compiler vectorizes (8 lanes per AVX2 register). The rare
+// events - noise shifts, hard sync, envelope steps - are handled in a scalar
+// pass over the lanes that need them.
+//
+// The bank is delta clocked like reSID's SAMPLE_FAST path. It models the
+// waveform generators and envelope generators of reSID; the filter, the
+// external filter and combined waveform write-back are not modelled, and hard
+// sync is resolved at sample granularity.
+class ChipBank {
+public:
+    // Lane arrays are padded to a multiple of this many chips.
+    static constexpr int kLaneAlign = 8;
+
+    // Size of the state block for nChips chips; the caller owns the memory.
+    static std::size_t memorySize(int nChips);
+    void init(void* memory, int nChips);
+
+    int numChips() const { return mNumChips; }
+
+    void setChipModel(int chip, reSID::chip_model model);
+    void writeFreq(int chip, int voice, reSID::reg16 freq);
+    void writePW(int chip, int voice, reSID::reg12 pw);
+    void writeControl(int chip, int voice, reSID::reg8 control);
+    void writeAttackDecay(int chip, int voice, reSID::reg8 attackDecay);
+    void writeSustainRelease(int chip, int voice, reSID::reg8 sustainRelease);
+
+    // Advance all chips by deltaT cycles.
+    void clock(reSID::cycle_count deltaT);
+
+    // Mixed voice output of a chip. Range [-3*2048*255, 3*2047*255].
+    int output(int chip) const;
+
+private:
+    enum EnvelopeState { ATTACK, DECAY_SUSTAIN, RELEASE };
+
+    void stepEnvelope(int lane, reSID::cycle_count deltaT);
+    void synchronize();
+    void shiftNoise(int lane, int count);
+    int voiceOutput(int lane, int chip) const;
+
+    int mNumChips;
+    // Row length of the lane arrays, padded to a multiple of kLaneAlign.
+    int mStride;
+    int mNumLanes;
+
+    // Waveform generator.
+    int32_t* mAccumulator;
+    int32_t* mFreq;
+    int32_t* mPW;
+    int32_t* mTest;
+    int32_t* mSync;
+    int32_t* mWaveform;
+    int32_t* mRingMsbMask;
+    int32_t* mNoNoise;
+    int32_t* mNoPulse;
+    int32_t* mPulseOutput;
+    int32_t* mShiftRegister;
+    int32_t* mMsbRising;
+    int32_t* mNoiseShifts;
+
+    // Envelope generator.
+    int32_t* mRateCounter;
+    int32_t* mRatePeriod;
+    int32_t* mEnvelopeStep;
+    int32_t* mExponentialCounter;
+    int32_t* mExponentialCounterPeriod;
+    int32_t* mEnvelopeCounter;
+    int32_t* mEnvelopeState;
+    int32_t* mHoldZero;
+    int32_t* mGate;
+    int32_t* mAttack;
+    int32_t* mDecay;
+    int32_t* mSustain;
+    int32_t* mRelease;
+
+    // Per chip.
+    int32_t* mChipModel;
+
+    static constexpr int kNumLaneArrays = 26;
+};
+
+// Bank UGen: renders one SID per output channel in a single calc call.
+//
+// In threaded mode the chips are split into partitions, which the render
+// workers clock in parallel while the DSP thread goes on with the rest of
+// the graph. The output of a block is then picked up in the next calc call,
+// so the bank runs one block late; the DSP thread itself only writes
+// registers and copies samples, and never waits for a worker. A partition a
+// worker has not finished by then repeats its previous block, and its
+// control register writes are kept for the next block it renders.
+class SIDBank : public SCUnit {
+public:
+    SIDBank();
+    ~SIDBank();
+
+private:
+    // Control register values a partition keeps for its next block.
+    static constexpr int kMaxControls = 8;
+
+    // A group of chips clocked together, by a render worker in threaded mode.
+    struct Partition : RenderJob {
+        ChipBank bank;
+        int firstChip;
+        // One row of samples per chip: the unit outputs, or in threaded mode
+        // a buffer owned by the partition.
+        float** rows;
+        int nSamples;
+        // Threaded mode: the last finished block, which the unit outputs
+        // while the workers render into rows.
+        float** lastRows;
+        int lastSamples;
+        float scale;
+        // 16.16 fixed point cycles per sample, and the fractional remainder.
+        reSID::cycle_count cyclesPerSample;
+        reSID::cycle_count sampleOffset;
+        // Control register values written in the block, in order: those of
+        // the blocks missed while a worker was still rendering, then the
+        // block's own. They are spread evenly over the block, so that a gate
+        // shorter than the missed blocks still triggers the envelopes.
+        reSID::reg8 controls[kMaxControls];
+        int numControls;
+        // DSP thread side: the values kept for the next block, which are
+        // moved to controls when it is submitted. Past kMaxControls, the
+        // newest value replaces the last one kept.
+        reSID::reg8 pendingControls[kMaxControls];
+        int numPending;
+        // The last value kept, to skip writes that change nothing.
+        reSID::reg8 prevControlReg;
+    };
+
+    // Start of the unit's memory, so that the partitions can be freed after
+    // the unit is gone.
+    struct MemoryHeader {
+        Partition* partitions;
+        int numPartitions;
+    };
+
+    void next(int nSamples);
+    void nextThreaded(int nSamples);
+    void writeInputs(Partition& partition, int nSamples);
+    void queueControl(Partition& partition);
+    static void render(RenderJob* job);
+    static bool waitForWorkers(World* world, void* memory);
+    static void freeMemory(World* world, void* memory);
+
+    void* mMemory;
+    Partition* mPartitions;
+    int mNumPartitions;
+
+    float* mFreqCache;
+};
+
+} // namespace SIDOsc
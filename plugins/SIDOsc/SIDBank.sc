@@ -0,0 +1,16 @@
+SIDBank : MultiOutUGen {
+    *ar { |freqs = #[440], gain = 1.0, waveform = 2, dacType = 0, gate = 1, threaded = 0|
+        // One SID chip per element of freqs; each chip gets its own output channel.
+        // waveform: SID control register bits 7-4 (1 = triangle, 2 = sawtooth, 4 = pulse, 8 = noise)
+        // dacType: 0 = MOS6581, 1 = MOS8580
+        // threaded: 1 renders on the plugin's worker threads, one block late
+        ^this.multiNewList(['audio', gain, waveform, dacType, gate, threaded] ++ freqs.asArray);
+    }
+    init { arg ... theInputs;
+        inputs = theInputs;
+        ^this.initOutputs(theInputs.size - 5, rate);
+    }
+    checkInputs {
+        ^this.checkValidInputs;
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "SC_PlugIn.hpp"
+#include <cstddef>
+
+extern InterfaceTable* ft;
+
+namespace SIDOsc {
+
+// SID clock of all units; every FREQ register value and cycles-per-sample
+// step in the plugin is derived from it.
+static constexpr double kClockFreq = 985248.0; // PAL SID clock
+//static constexpr double kClockFreq = 1022727.0;  // NTSC SID clock
+
+// reSID memory hooks: resampling buffers come from the real-time pool of the
+// World, so that node construction never touches malloc on the audio thread.
+// Pass the unit's World as the context of SID::set_allocator().
+inline void* rtAllocHook(void* world, std::size_t size) {
+    return RTAlloc(static_cast<World*>(world), size);
+}
+
+inline void rtFreeHook(void* world, void* ptr) {
+    RTFree(static_cast<World*>(world), ptr);
+}
+
+} // namespace SIDOsc
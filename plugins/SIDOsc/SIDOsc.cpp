@@ -1,91 +1,596 @@
 #define SC_USE_DEPRECATED 1
 #include "SIDOsc.hpp"
+#include "SIDDefs.hpp"
+#include "SIDBank.hpp"
+#include "SIDPlayer.hpp"
+#include "FirTables.hpp"
 #include "envelope.h"
 #include <cstdio>
+#include <cstring>
 #include <cmath>
 #include <algorithm>
+#include <type_traits>
 
 using namespace reSID;
 
-static InterfaceTable* ft;
+InterfaceTable* ft;
 
 namespace SIDOsc {
 
 // Constants
-static constexpr double kClockFreq    = 985248.0; // PAL SID clock
-//static constexpr double kClockFreq = 1022727.0;  // NTSC SID clock
-
 static constexpr double kAccResolution = 16777216.0; // = 2^24, 24-bit fixed-point phase accumulator
 //In the original reSID code, the analog filter (VCF) integrators and feedback loops are implemented in fixed‑point with an 11‑bit fractional resolution. Internally, filter state variables are scaled by 2048 so that the C‑code can stay in integer arithmetic
 static constexpr int    kFilterRes    = 2048; // = 2^11
 static constexpr int    kDACMaxValue  = 4095; // = 2^12-1, the full‑scale count of a 12‑bit DAC
 static constexpr int    kOutNorm      = 32767; // = 2^15-1, the max pos value of a signed 16‑bit sample. After we sum the three voices’ 12‑bit outputs, we divide by kOutNorm to map into the conventional signed‑16 range (−1.0…+1.0 in float)
+static constexpr int    kFreqRegMax   = 0xFFFF; // the SID FREQ register is 16 bits wide (~3.9 kHz at the PAL clock)
+static constexpr float  kVoiceNorm    = 1566720.0f; // = 3*2048*255, full scale of three enveloped voices
+static constexpr int    kFixpShift    = 16; // 16.16 fixed point cycle counting, as in reSID
+static constexpr int    kFixpMask     = (1 << kFixpShift) - 1;
+
+// Input indices.
+static constexpr int kInSampling = 5; // SIDOsc: < 0 legacy per-sample clocking; SIDOscFull: 0-3 reSID sampling_method
+// SIDOscFull filter inputs, in SID register units.
+static constexpr int kInCutoff     = 6;  // FC, 0-2047
+static constexpr int kInResonance  = 7;  // RES, 0-15
+static constexpr int kInFilter     = 8;  // FILT routing bits: 1, 2, 4 = voices, 8 = external input
+static constexpr int kInFilterMode = 9;  // 1 = low pass, 2 = band pass, 4 = high pass, 8 = voice 3 off
+static constexpr int kInVolume     = 10; // VOL, 0-15
+// Envelope inputs, 0-15 each: attack, decay, sustain, release follow at
+// consecutive indices. SIDOscFull has them after its filter inputs.
+static constexpr int kInAttack     = 6;
+static constexpr int kInFullAttack = 11;
+// doneAction, applied once the gate is off and the voices have gone silent.
+static constexpr int kInDoneAction     = 10;
+static constexpr int kInFullDoneAction = 15;
+// SIDOscFull output level, in 16-bit LSB, below which it counts as silent.
+static constexpr int kSilenceLevel = 16;
 
-// First arg: reference voltage
-// Second arg: termination‑resistor flag Boolean -- the final termination resistor in the DAC ladder causes a little bump/distortion near full‑scale
-const reSID::DAC<12> SIDOsc::dac6581(2.20, false); // that’s the nominal peak amplitude you get out of a real MOS 6581’s resistor ladder.
-const reSID::DAC<12> SIDOsc::dac8580(2.00, true); // it's less here because of the addition of the termination-resistor
+// Waveform D/A output of each chip model centred at mid-scale, so that a
+// voice's contribution to the mix is one lookup of its 12-bit waveform
+// output. This folds the R-2R ladder of WaveformGenerator::model_dac (2R/R =
+// 2.20 without termination for the 6581, 2.00 with termination for the 8580)
+// and the centring of the mix into one table. Built at plugin load.
+static short gVoiceDac[2][1 << 12];
+
+static void buildVoiceDac() {
+    for (int model = 0; model < 2; model++) {
+        for (int i = 0; i < (1 << 12); i++) {
+            gVoiceDac[model][i] = static_cast<short>(WaveformGenerator::model_dac[model][i] - 0x800);
+        }
+    }
+}
 
 // Helper: if input index is beyond mNumInputs, return a default.
 static inline float getInputDefault(SCUnit* unit, int index, float def) {
-    return (index < unit->mNumInputs) ? unit->in0(index) : def;
+    return (index < static_cast<int>(unit->mNumInputs)) ? unit->in0(index) : def;
+}
+
+// FREQ register value of a frequency in Hz, clamped to the register range.
+// Negative, NaN and infinite frequencies never reach the integer conversion.
+static inline unsigned int frequencyRegister(float freq) {
+    const double value = (freq * kAccResolution) / kClockFreq;
+    return (value > 0.0) ? static_cast<unsigned int>(std::min(value, static_cast<double>(kFreqRegMax))) : 0u;
+}
+
+// frequencyRegister() for a whole chunk. The increments go straight into the
+// accumulator increment, which is what writeFREQ_LO/HI end up setting.
+static inline void frequencyIncrements(const float* freq, reSID::reg24* increment, int n) {
+    for (int i = 0; i < n; ++i) {
+        increment[i] = frequencyRegister(freq[i]);
+    }
 }
 
 SIDOsc::SIDOsc()
     : mGain(1.0f)
+    , mBlepIndex(0)
+    , mSampleOffset(0)
     , freqValue(0)
     , mPrevControlReg(0xFF)
     , mPrevGate(false)
-    // Envelope parameters removed:
-    // , mPrevAttackInput(-1.0f)
-    // , mPrevDecayInput(-1.0f)
-    // , mPrevSustainInput(-1.0f)
-    // , mPrevReleaseInput(-1.0f)
-    , mPrevFreq(-1.0f)
+    , mPrevAttackDecay(0x00)
+    , mPrevSustainRelease(0xF0)
+    , mHeldEnvelopeCycles(0)
+    , mGateSeen(false)
 {
+    const int dacType = static_cast<int>(getInputDefault(this, 3, 0.0f));
+    const chip_model model = (dacType == 1) ? MOS8580 : MOS6581;
+    mVoiceDac = gVoiceDac[model];
+
     // Initialize three voices.
     for (int v = 0; v < 3; v++) {
-        voice[v].set_chip_model(MOS6581);
+        voice[v].set_chip_model(model);
     }
     // Link voices for sync.
     voice[0].set_sync_source(&voice[2]);
     voice[1].set_sync_source(&voice[0]);
     voice[2].set_sync_source(&voice[1]);
 
-    // Filter and envelope init for later
-    // filter.set_chip_model(MOS6581);
-    // filter.enable_filter(true);
-    // extFilter.enable_filter(true);
-
-    // Potentiometers (possibly used internally by reSID).
-    potX.readPOT();
-    potY.readPOT();
-
-    // Envelope defaults for later
-    // for (int v = 0; v < 3; v++) {
-    //     voice[v].envelope.reset();
-    //     voice[v].envelope.writeATTACK_DECAY(0x00);
-    //     voice[v].envelope.writeSUSTAIN_RELEASE(0xFF);
-    // }
-    
-    mCalcFunc = make_calc_function<SIDOsc, &SIDOsc::next>();
-    next(1);
+    const int sampling = static_cast<int>(getInputDefault(this, kInSampling, 0.0f));
+    if (sampling < 0) {
+        mCalcFunc = make_calc_function<SIDOsc, &SIDOsc::next>();
+        next(1);
+        return;
+    }
+
+    // Delta-clocked mode: same register defaults as SIDOscFull. The envelope
+    // inputs are written from the first calc call on.
+    mCyclesPerSample = static_cast<cycle_count>(kClockFreq / sampleRate() * (1 << kFixpShift) + 0.5);
+    for (int v = 0; v < 3; v++) {
+        voice[v].wave.writePW_LO(0x00);
+        voice[v].wave.writePW_HI(0x08);
+        voice[v].envelope.writeATTACK_DECAY(0x00);
+        voice[v].envelope.writeSUSTAIN_RELEASE(0xF0);
+    }
+
+    if (sampling == 1) {
+        std::fill(mPhaseFraction, mPhaseFraction + 3, 0u);
+        std::fill(&mBlepBuffer[0][0], &mBlepBuffer[0][0] + 3 * kMinBlepTaps, 0.0f);
+        mCalcFunc = make_calc_function<SIDOsc, &SIDOsc::next_blep>();
+        next_blep(1);
+        return;
+    }
+
+    UnitCalcFunc fixed = nullptr;
+    if (inRate(2) == calc_ScalarRate) {
+        fixed = fixedCalcFunction(static_cast<int>(in0(2)), model);
+    }
+    if (fixed) {
+        mCalcFunc = fixed;
+        (*fixed)(this, 1);
+    } else if (inRate(0) == calc_FullRate) {
+        mCalcFunc = make_calc_function<SIDOsc, &SIDOsc::next_delta_ar>();
+        next_delta_ar(1);
+    } else {
+        mCalcFunc = make_calc_function<SIDOsc, &SIDOsc::next_delta>();
+        next_delta(1);
+    }
+}
+
+void SIDOsc::writeFrequency(float freq) {
+    const unsigned int value = frequencyRegister(freq);
+    if (value == this->freqValue) {
+        return;
+    }
+    this->freqValue = value;
+    for (int v = 0; v < 3; v++) {
+        voice[v].wave.writeFREQ_LO(static_cast<reSID::reg8>(value & 0xFF));
+        voice[v].wave.writeFREQ_HI(static_cast<reSID::reg8>((value >> 8) & 0xFF));
+    }
+    SIDOSC_COUNT(registerWrites, 6);
+}
+
+void SIDOsc::writeControl(reSID::reg8 control) {
+    if (control == mPrevControlReg) {
+        return;
+    }
+    for (int v = 0; v < 3; v++) {
+        voice[v].writeCONTROL_REG(control);
+    }
+    mPrevControlReg = control;
+    SIDOSC_COUNT(registerWrites, 3);
+}
+
+// Envelope register values from four consecutive inputs.
+static inline void readEnvelope(SCUnit* unit, int index, reSID::reg8& attackDecay, reSID::reg8& sustainRelease) {
+    const int attack  = static_cast<int>(getInputDefault(unit, index, 0.0f)) & 0x0f;
+    const int decay   = static_cast<int>(getInputDefault(unit, index + 1, 0.0f)) & 0x0f;
+    const int sustain = static_cast<int>(getInputDefault(unit, index + 2, 15.0f)) & 0x0f;
+    const int release = static_cast<int>(getInputDefault(unit, index + 3, 0.0f)) & 0x0f;
+    attackDecay    = static_cast<reSID::reg8>((attack << 4) | decay);
+    sustainRelease = static_cast<reSID::reg8>((sustain << 4) | release);
+}
+
+void SIDOsc::writeEnvelope() {
+    reSID::reg8 attackDecay, sustainRelease;
+    readEnvelope(this, kInAttack, attackDecay, sustainRelease);
+    if (attackDecay != mPrevAttackDecay) {
+        for (int v = 0; v < 3; v++) {
+            voice[v].envelope.writeATTACK_DECAY(attackDecay);
+        }
+        mPrevAttackDecay = attackDecay;
+        SIDOSC_COUNT(registerWrites, 3);
+    }
+    if (sustainRelease != mPrevSustainRelease) {
+        for (int v = 0; v < 3; v++) {
+            voice[v].envelope.writeSUSTAIN_RELEASE(sustainRelease);
+        }
+        mPrevSustainRelease = sustainRelease;
+        SIDOSC_COUNT(registerWrites, 3);
+    }
+}
+
+// A held envelope only changes on register writes, which happen at block
+// boundaries. Its rate counter still runs, since that decides the timing of
+// the next step (and the ADSR delay bug), so the skipped cycles are clocked
+// in one go at the end of the block.
+inline bool SIDOsc::envelopesHeld() {
+    return voice[0].envelope.held() && voice[1].envelope.held() && voice[2].envelope.held();
+}
+
+inline void SIDOsc::clockHeldEnvelopes() {
+    if (mHeldEnvelopeCycles) {
+        for (int v = 0; v < 3; v++) {
+            voice[v].envelope.clock(mHeldEnvelopeCycles);
+        }
+        mHeldEnvelopeCycles = 0;
+    }
+}
+
+// With all envelopes frozen at zero the output is exactly zero until the next
+// register write, so the block is not rendered. The oscillators and envelopes
+// are advanced by one clock(delta_t) call each, which keeps the oscillator
+// phase and the ADSR delay timing for when the voices wake up.
+bool SIDOsc::renderIdle(int nSamples, bool gate) {
+    if (!(voice[0].envelope.silent() && voice[1].envelope.silent() && voice[2].envelope.silent())) {
+        return false;
+    }
+
+    // The sum of nSamples nextDeltaT() steps.
+    const int64_t nextSampleOffset = mSampleOffset + static_cast<int64_t>(nSamples) * mCyclesPerSample + (1 << (kFixpShift - 1));
+    const cycle_count deltaT = static_cast<cycle_count>(nextSampleOffset >> kFixpShift);
+    mSampleOffset = static_cast<cycle_count>(nextSampleOffset & kFixpMask) - (1 << (kFixpShift - 1));
+    SIDOSC_COUNT(cycles, deltaT);
+
+    for (int v = 0; v < 3; v++) {
+        voice[v].wave.clock(deltaT);
+        voice[v].envelope.clock(deltaT);
+    }
+    ClearUnitOutputs(this, nSamples);
+
+    if (mGateSeen && !gate && !mDone) {
+        mDone = true;
+        DoneAction(static_cast<int>(getInputDefault(this, kInDoneAction, 0.0f)), this);
+    }
+    return true;
+}
+
+inline cycle_count SIDOsc::nextDeltaT() {
+    // The control register never sets SYNC, so unlike SID::clock(delta_t)
+    // there is no need to stop at accumulator MSB toggles.
+    const cycle_count nextSampleOffset = mSampleOffset + mCyclesPerSample + (1 << (kFixpShift - 1));
+    mSampleOffset = (nextSampleOffset & kFixpMask) - (1 << (kFixpShift - 1));
+    SIDOSC_COUNT(cycles, nextSampleOffset >> kFixpShift);
+    return nextSampleOffset >> kFixpShift;
+}
+
+inline int SIDOsc::clockSample(bool envelopesHeld) {
+    const cycle_count deltaT = nextDeltaT();
+
+    if (envelopesHeld) {
+        mHeldEnvelopeCycles += deltaT;
+    } else {
+        for (int v = 0; v < 3; v++) {
+            voice[v].envelope.clock(deltaT);
+        }
+    }
+    for (int v = 0; v < 3; v++) {
+        voice[v].wave.clock(deltaT);
+    }
+    for (int v = 0; v < 3; v++) {
+        voice[v].wave.synchronize();
+    }
+    for (int v = 0; v < 3; v++) {
+        voice[v].wave.set_waveform_output(deltaT);
+        // Centred at DAC mid-scale: there is no external filter to remove
+        // the 6581 waveform DC offset.
+        mVoiceOutput[v] = mVoiceDac[voice[v].wave.waveform_output] * voice[v].envelope.output();
+    }
+    return mVoiceOutput[0] + mVoiceOutput[1] + mVoiceOutput[2];
+}
+
+// The voices are already separate before the mix, so the per-voice outputs
+// come from the same clocking pass. Each voice is scaled to full range.
+inline void SIDOsc::storeSample(int i, int sum, float scale) {
+    if (mNumOutputs < 3) {
+        out(0)[i] = sum * scale;
+        return;
+    }
+    for (int v = 0; v < 3; v++) {
+        out(v)[i] = mVoiceOutput[v] * (3.0f * scale);
+    }
+}
+
+void SIDOsc::next_delta(int nSamples) {
+    SIDOSC_BLOCK(nSamples);
+    mGain = in0(1);
+    const int   waveformType = static_cast<int>(in0(2));
+    const bool  currentGate  = (in0(4) > 0.5f);
+
+    writeControl(static_cast<reSID::reg8>((waveformType << 4) | (currentGate ? 0x01 : 0x00)));
+    writeEnvelope();
+    writeFrequency(in0(0));
+    mGateSeen |= currentGate;
+    if (renderIdle(nSamples, currentGate)) {
+        return;
+    }
+
+    const bool held = envelopesHeld();
+    const float scale = mGain / kVoiceNorm;
+    for (int i = 0; i < nSamples; ++i) {
+        storeSample(i, clockSample(held), scale);
+    }
+    clockHeldEnvelopes();
+}
+
+void SIDOsc::next_delta_ar(int nSamples) {
+    SIDOSC_BLOCK(nSamples);
+    const float* freqInput   = in(0);
+    mGain = in0(1);
+    const int   waveformType = static_cast<int>(in0(2));
+    const bool  currentGate  = (in0(4) > 0.5f);
+
+    writeControl(static_cast<reSID::reg8>((waveformType << 4) | (currentGate ? 0x01 : 0x00)));
+    writeEnvelope();
+    mGateSeen |= currentGate;
+    if (renderIdle(nSamples, currentGate)) {
+        return;
+    }
+
+    const bool held = envelopesHeld();
+    const float scale = mGain / kVoiceNorm;
+    reSID::reg24 increment[kFreqChunk];
+    for (int i = 0; i < nSamples; i += kFreqChunk) {
+        const int chunk = std::min(nSamples - i, kFreqChunk);
+        frequencyIncrements(freqInput + i, increment, chunk);
+        for (int j = 0; j < chunk; ++j) {
+            for (int v = 0; v < 3; v++) {
+                voice[v].wave.freq = increment[j];
+            }
+            storeSample(i + j, clockSample(held), scale);
+        }
+        this->freqValue = increment[chunk - 1];
+    }
+    clockHeldEnvelopes();
+}
+
+template <int Waveform, chip_model Model>
+inline int SIDOsc::clockSampleFixed(bool envelopesHeld) {
+    const cycle_count deltaT = nextDeltaT();
+
+    if (envelopesHeld) {
+        mHeldEnvelopeCycles += deltaT;
+    } else {
+        for (int v = 0; v < 3; v++) {
+            voice[v].envelope.clock(deltaT);
+        }
+    }
+    for (int v = 0; v < 3; v++) {
+        WaveformGenerator& wave = voice[v].wave;
+        if (Waveform == 0x8) {
+            // Noise needs the shift register clocking.
+            wave.clock(deltaT);
+        } else {
+            wave.accumulator = (wave.accumulator + deltaT * wave.freq) & 0xffffff;
+        }
+
+        // The table contents of WaveformGenerator::build_tables(), computed.
+        reg12 waveformOutput;
+        if (Waveform == 0x1) {
+            const reg24 msb = wave.accumulator & 0x800000;
+            waveformOutput = ((wave.accumulator ^ -!!msb) >> 11) & 0xffe;
+        } else if (Waveform == 0x2) {
+            waveformOutput = wave.accumulator >> 12;
+        } else if (Waveform == 0x4) {
+            waveformOutput = wave.pulse_output = (wave.accumulator >> 12) >= wave.pw ? 0xfff : 0x000;
+        } else {
+            waveformOutput = wave.noise_output;
+        }
+        wave.waveform_output = wave.osc3 = waveformOutput;
+
+        mVoiceOutput[v] = gVoiceDac[Model][waveformOutput] * voice[v].envelope.output();
+    }
+    return mVoiceOutput[0] + mVoiceOutput[1] + mVoiceOutput[2];
+}
+
+template <int Waveform, chip_model Model>
+void SIDOsc::next_fixed(int nSamples) {
+    SIDOSC_BLOCK(nSamples);
+    const float* freqInput   = in(0);
+    const bool  freqAudioRate = (inRate(0) == calc_FullRate);
+    mGain = in0(1);
+    const bool  currentGate  = (in0(4) > 0.5f);
+
+    writeControl(static_cast<reSID::reg8>((Waveform << 4) | (currentGate ? 0x01 : 0x00)));
+    writeEnvelope();
+    if (!freqAudioRate) {
+        writeFrequency(freqInput[0]);
+    }
+    mGateSeen |= currentGate;
+    if (renderIdle(nSamples, currentGate)) {
+        return;
+    }
+
+    const bool held = envelopesHeld();
+    const float scale = mGain / kVoiceNorm;
+    if (!freqAudioRate) {
+        for (int i = 0; i < nSamples; ++i) {
+            storeSample(i, clockSampleFixed<Waveform, Model>(held), scale);
+        }
+        clockHeldEnvelopes();
+        return;
+    }
+
+    reSID::reg24 increment[kFreqChunk];
+    for (int i = 0; i < nSamples; i += kFreqChunk) {
+        const int chunk = std::min(nSamples - i, kFreqChunk);
+        frequencyIncrements(freqInput + i, increment, chunk);
+        for (int j = 0; j < chunk; ++j) {
+            for (int v = 0; v < 3; v++) {
+                voice[v].wave.freq = increment[j];
+            }
+            storeSample(i + j, clockSampleFixed<Waveform, Model>(held), scale);
+        }
+        this->freqValue = increment[chunk - 1];
+    }
+    clockHeldEnvelopes();
+}
+
+// Specialized kernels exist for the single waveforms; combined waveforms and
+// modulated waveform inputs use the generic path.
+UnitCalcFunc SIDOsc::fixedCalcFunction(int waveformType, chip_model model) {
+    if (model == MOS8580) {
+        switch (waveformType) {
+        case 0x1: return make_calc_function<SIDOsc, &SIDOsc::next_fixed<0x1, MOS8580>>();
+        case 0x2: return make_calc_function<SIDOsc, &SIDOsc::next_fixed<0x2, MOS8580>>();
+        case 0x4: return make_calc_function<SIDOsc, &SIDOsc::next_fixed<0x4, MOS8580>>();
+        case 0x8: return make_calc_function<SIDOsc, &SIDOsc::next_fixed<0x8, MOS8580>>();
+        default: return nullptr;
+        }
+    }
+    switch (waveformType) {
+    case 0x1: return make_calc_function<SIDOsc, &SIDOsc::next_fixed<0x1, MOS6581>>();
+    case 0x2: return make_calc_function<SIDOsc, &SIDOsc::next_fixed<0x2, MOS6581>>();
+    case 0x4: return make_calc_function<SIDOsc, &SIDOsc::next_fixed<0x4, MOS6581>>();
+    case 0x8: return make_calc_function<SIDOsc, &SIDOsc::next_fixed<0x8, MOS6581>>();
+    default: return nullptr;
+    }
+}
+
+// The SID control register of SIDOsc never sets TEST, SYNC or RING, which
+// leaves the sawtooth wrap and the pulse comparator as the only edges.
+// Noise is left as it is: its steps are random, and it is broadband anyway.
+// The level does not include noise.
+inline int SIDOsc::blepLevel(const WaveformGenerator& wave, int ix) const {
+    const reSID::reg12 pulse = (static_cast<reSID::reg12>(ix) >= wave.pw) ? 0xfff : 0x000;
+    return mVoiceDac[wave.wave[ix] & (wave.no_pulse | pulse)];
+}
+
+inline void SIDOsc::addBlep(int v, float delay, float step) {
+    const float* residual = minBlepResidual(delay);
+    float* blep = mBlepBuffer[v];
+    for (int k = 0; k < kMinBlepTaps; k++) {
+        blep[(mBlepIndex + k) & (kMinBlepTaps - 1)] += step * residual[k];
+    }
+}
+
+inline float SIDOsc::clockSampleBlep(bool envelopesHeld, float* voiceOutput) {
+    // The envelopes are clocked in whole cycles as in clockSample().
+    const cycle_count deltaT = nextDeltaT();
+    if (envelopesHeld) {
+        mHeldEnvelopeCycles += deltaT;
+    } else {
+        for (int v = 0; v < 3; v++) {
+            voice[v].envelope.clock(deltaT);
+        }
+    }
+
+    // Accumulator phase with kFixpShift fractional bits, and its wrap.
+    constexpr uint64_t kPhaseWrap = static_cast<uint64_t>(1) << (24 + kFixpShift);
+    float sum = 0.0f;
+    for (int v = 0; v < 3; v++) {
+        WaveformGenerator& wave = voice[v].wave;
+        const uint64_t phase = (static_cast<uint64_t>(wave.accumulator) << kFixpShift) | mPhaseFraction[v];
+        const uint64_t increment = static_cast<uint64_t>(wave.freq) * mCyclesPerSample;
+        const uint64_t phaseNext = phase + increment;
+        const reSID::reg24 accumulator = static_cast<reSID::reg24>(phase >> kFixpShift);
+        const reSID::reg24 accumulatorNext = static_cast<reSID::reg24>(phaseNext >> kFixpShift);
+
+        // Accumulator bit 19 going high clocks the noise register, as in
+        // WaveformGenerator::clock(delta_t).
+        const reSID::reg24 shifts = ((accumulatorNext + 0x80000) >> 20) - ((accumulator + 0x80000) >> 20);
+        wave.accumulator = accumulatorNext & 0xffffff;
+        mPhaseFraction[v] = static_cast<uint32_t>(phaseNext & kFixpMask);
+        if (shifts) {
+            wave.clock_shift_register(shifts);
+        }
+        wave.pulse_output = (wave.accumulator >> 12) >= wave.pw ? 0xfff : 0x000;
+        wave.set_waveform_output(deltaT);
+
+        // The naive waveform, delayed to line up with the minBLEP steps.
+        int level = mVoiceDac[wave.waveform_output];
+        if (!(wave.waveform & 0x8)) {
+            const uint64_t lag = static_cast<uint64_t>(increment * gMinBlepDelay);
+            level = blepLevel(wave, static_cast<int>(((phaseNext - lag) >> (kFixpShift + 12)) & 0xfff));
+        }
+
+        const int envelope = voice[v].envelope.output();
+        if (envelope && wave.waveform && !(wave.waveform & 0x8) && increment) {
+            const float perIncrement = 1.0f / increment;
+            if (phaseNext >= kPhaseWrap) {
+                const int step = blepLevel(wave, 0) - blepLevel(wave, 0xfff);
+                if (step) {
+                    addBlep(v, (phaseNext - kPhaseWrap) * perIncrement, static_cast<float>(step * envelope));
+                }
+            }
+            if (!wave.no_pulse && wave.pw) {
+                // The comparator goes high at pw, before or after a wrap.
+                const uint64_t edge = static_cast<uint64_t>(wave.pw) << (12 + kFixpShift);
+                const int step = (blepLevel(wave, wave.pw) - blepLevel(wave, wave.pw - 1)) * envelope;
+                if (phase < edge && edge <= phaseNext) {
+                    addBlep(v, (phaseNext - edge) * perIncrement, static_cast<float>(step));
+                } else if (edge + kPhaseWrap <= phaseNext) {
+                    addBlep(v, (phaseNext - edge - kPhaseWrap) * perIncrement, static_cast<float>(step));
+                }
+            }
+        }
+
+        float* blep = mBlepBuffer[v];
+        voiceOutput[v] = level * envelope + blep[mBlepIndex];
+        blep[mBlepIndex] = 0.0f;
+        sum += voiceOutput[v];
+    }
+    mBlepIndex = (mBlepIndex + 1) & (kMinBlepTaps - 1);
+    return sum;
+}
+
+void SIDOsc::next_blep(int nSamples) {
+    SIDOSC_BLOCK(nSamples);
+    const float* freqInput   = in(0);
+    const bool  freqAudioRate = (inRate(0) == calc_FullRate);
+    mGain = in0(1);
+    const int   waveformType = static_cast<int>(in0(2));
+    const bool  currentGate  = (in0(4) > 0.5f);
+
+    writeControl(static_cast<reSID::reg8>((waveformType << 4) | (currentGate ? 0x01 : 0x00)));
+    writeEnvelope();
+    if (!freqAudioRate) {
+        writeFrequency(freqInput[0]);
+    }
+    mGateSeen |= currentGate;
+    if (renderIdle(nSamples, currentGate)) {
+        return;
+    }
+
+    const bool held = envelopesHeld();
+    const float scale = mGain / kVoiceNorm;
+    float voiceOutput[3];
+    reSID::reg24 increment[kFreqChunk];
+    for (int i = 0; i < nSamples; i += kFreqChunk) {
+        const int chunk = std::min(nSamples - i, kFreqChunk);
+        if (freqAudioRate) {
+            frequencyIncrements(freqInput + i, increment, chunk);
+        }
+        for (int j = 0; j < chunk; ++j) {
+            if (freqAudioRate) {
+                for (int v = 0; v < 3; v++) {
+                    voice[v].wave.freq = increment[j];
+                }
+            }
+            const float sum = clockSampleBlep(held, voiceOutput);
+            if (mNumOutputs < 3) {
+                out(0)[i + j] = sum * scale;
+            } else {
+                for (int v = 0; v < 3; v++) {
+                    out(v)[i + j] = voiceOutput[v] * (3.0f * scale);
+                }
+            }
+        }
+        if (freqAudioRate) {
+            this->freqValue = increment[chunk - 1];
+        }
+    }
+    clockHeldEnvelopes();
 }
 
 void SIDOsc::next(int nSamples) {
+    SIDOSC_BLOCK(nSamples);
     // --- Read primary parameters (from the input buffers) ---
     const float* freqInput   = in(0);
     const float gainInput    = in0(1);
     const int   waveformType = static_cast<int>(in0(2));
-    const int   dacType      = static_cast<int>(in0(3));  // Unused for now.
     const float gateInput    = in0(4);
 
-    // Envelope parameters for later
-    // float attackInput  = (mNumInputs > 7)  ? in0(7)  : 0.0f;
-    // float decayInput   = (mNumInputs > 8)  ? in0(8)  : 0.0f;
-    // float sustainInput = (mNumInputs > 9)  ? in0(9)  : 1.0f;
-    // float releaseInput = (mNumInputs > 10) ? in0(10) : 1.0f;
-
     mGain = gainInput;
 
     // --- Build new control register (upper 4 bits: waveformType; bit0: gate) ---
@@ -98,27 +603,44 @@ void SIDOsc::next(int nSamples) {
             voice[v].writeCONTROL_REG(newControlReg);
         }
         mPrevGate = currentGate;
+        SIDOSC_COUNT(registerWrites, 3);
     }
-    // TODO: ADD Envelope updates
+    // There are no envelopes on this path: with one cycle per sample they
+    // would run some twenty times too slow, so the envelope and doneAction
+    // inputs are ignored and the output is the bare waveform.
 
     // --- Frequency and oscillator update ---
-    const float freqEpsilon = 0.001f;
+    // Registers are only written when the quantized value changes.
+    const bool freqAudioRate = (inRate(0) == calc_FullRate);
     float* outputBuffer = this->out(0);
+    // The voices are mixed in integers, relative to the DAC output for a zero
+    // waveform as in Voice::output(), and converted to float once.
+    const int waveZeroOffset = 0x800 - voice[0].getWaveZero();
+    const float voiceScale = mGain / kOutNorm;
+    const float mixScale = voiceScale / 3.0f;
+    if (!freqAudioRate && freqInput[0] <= 0.0f) {
+        ClearUnitOutputs(this, nSamples);
+        return;
+    }
     for (int i = 0; i < nSamples; ++i) {
-        float freq = (inRate(0) == calc_FullRate) ? freqInput[i] : in0(0);
+        float freq = freqAudioRate ? freqInput[i] : freqInput[0];
         if (freq <= 0.0f) {
-            outputBuffer[i] = 0.0f;
+            for (uint32 o = 0; o < mNumOutputs; o++) {
+                out(o)[i] = 0.0f;
+            }
             continue;
         }
-        if (fabs(freq - mPrevFreq) > freqEpsilon) {
-            this->freqValue = static_cast<unsigned int>((freq * kAccResolution) / kClockFreq);
+        const unsigned int value = frequencyRegister(freq);
+        if (value != this->freqValue) {
+            this->freqValue = value;
             for (int v = 0; v < 3; v++) {
-                voice[v].wave.writeFREQ_LO(static_cast<reSID::reg8>(this->freqValue & 0xFF));
-                voice[v].wave.writeFREQ_HI(static_cast<reSID::reg8>((this->freqValue >> 8) & 0xFF));
+                voice[v].wave.writeFREQ_LO(static_cast<reSID::reg8>(value & 0xFF));
+                voice[v].wave.writeFREQ_HI(static_cast<reSID::reg8>((value >> 8) & 0xFF));
             }
-            mPrevFreq = freq;
+            SIDOSC_COUNT(registerWrites, 6);
         }
         // Clock the oscillators.
+        SIDOSC_COUNT(cycles, 1);
         for (int v = 0; v < 3; v++) {
             voice[v].wave.clock();
         }
@@ -127,20 +649,342 @@ void SIDOsc::next(int nSamples) {
         }
         for (int v = 0; v < 3; v++) {
             voice[v].wave.set_waveform_output();
+            mVoiceOutput[v] = mVoiceDac[voice[v].wave.waveform_output] + waveZeroOffset;
+        }
+        if (mNumOutputs >= 3) {
+            for (int v = 0; v < 3; v++) {
+                out(v)[i] = mVoiceOutput[v] * voiceScale;
+            }
+            continue;
+        }
+        outputBuffer[i] = (mVoiceOutput[0] + mVoiceOutput[1] + mVoiceOutput[2]) * mixScale;
+    }
+}
+
+SIDOscFull::SIDOscFull()
+    : mGain(1.0f)
+    , freqValue(0)
+    , mPrevControlReg(0xFF)
+    , mPrevCutoff(0)
+    , mPrevResFilt(0)
+    , mPrevModeVol(0)
+    , mPrevAttackDecay(0x00)
+    , mPrevSustainRelease(0xF0)
+    , mGateSeen(false)
+{
+    const int dacType = static_cast<int>(getInputDefault(this, 3, 0.0f));
+    sid.set_chip_model(dacType == 1 ? MOS8580 : MOS6581);
+
+    sid.set_allocator(rtAllocHook, rtFreeHook, mWorld);
+
+    const int sampling = std::max(0, static_cast<int>(getInputDefault(this, kInSampling, 0.0f)));
+    mSampling = static_cast<sampling_method>(std::min(sampling, static_cast<int>(SAMPLE_RESAMPLE_FASTMEM)));
+    setSamplingParameters(sampleRate());
+
+    // Attack 2 ms, full sustain, release 6 ms; 50% pulse width; full volume.
+    for (int v = 0; v < 3; v++) {
+        sid.write(v * 7 + 0x02, 0x00);
+        sid.write(v * 7 + 0x03, 0x08);
+        sid.write(v * 7 + 0x05, 0x00);
+        sid.write(v * 7 + 0x06, 0xF0);
+    }
+    // Filter and volume registers from the inputs, applied without clocking.
+    queueFilter();
+    mQueue.render(sid, nullptr, 0, mGain);
+
+    mCalcFunc = make_calc_function<SIDOscFull, &SIDOscFull::next>();
+    next(1);
+}
+
+void SIDOscFull::setSamplingParameters(double sampleFreq) {
+#if SIDOSC_INSTRUMENT
+    const sampling_method method = setUnitSampling(this, sid, kClockFreq, mSampling, sampleFreq, "SIDOscFull");
+    mConvolutionsPerSample = (method == SAMPLE_RESAMPLE) ? 2 : (method == SAMPLE_RESAMPLE_FASTMEM) ? 1 : 0;
+#else
+    setUnitSampling(this, sid, kClockFreq, mSampling, sampleFreq, "SIDOscFull");
+#endif
+    mCyclesPerSample = static_cast<cycle_count>(kClockFreq / sampleFreq * (1 << kFixpShift) + 0.5);
+}
+
+void SIDOscFull::queueFrequency(float freq, cycle_count cycle) {
+    const unsigned int value = frequencyRegister(freq);
+    const unsigned int changed = value ^ this->freqValue;
+    if (!changed) {
+        return;
+    }
+    this->freqValue = value;
+    for (int v = 0; v < 3; v++) {
+        if (changed & 0x00FF) {
+            mQueue.push(cycle, v * 7 + 0x00, static_cast<reSID::reg8>(value & 0xFF));
+        }
+        if (changed & 0xFF00) {
+            mQueue.push(cycle, v * 7 + 0x01, static_cast<reSID::reg8>((value >> 8) & 0xFF));
         }
-        float sumVoiceOutput = 0.0f;
+    }
+}
+
+void SIDOscFull::queueControl(reSID::reg8 control, cycle_count cycle) {
+    if (control == mPrevControlReg) {
+        return;
+    }
+    for (int v = 0; v < 3; v++) {
+        mQueue.push(cycle, v * 7 + 0x04, control);
+    }
+    mPrevControlReg = control;
+}
+
+// The filter registers are control rate. Writes happen only when a register
+// value changes, so a cutoff sweep costs one or two FC writes per block and
+// the RES/FILT and MODE/VOL recalculations only run on changes.
+void SIDOscFull::queueFilter() {
+    const int cutoff = std::min(std::max(static_cast<int>(getInputDefault(this, kInCutoff, 2047.0f)), 0), 0x7ff);
+    const int resonance = static_cast<int>(getInputDefault(this, kInResonance, 0.0f)) & 0x0f;
+    const int filter = static_cast<int>(getInputDefault(this, kInFilter, 0.0f)) & 0x0f;
+    const int filterMode = static_cast<int>(getInputDefault(this, kInFilterMode, 0.0f)) & 0x0f;
+    const int volume = static_cast<int>(getInputDefault(this, kInVolume, 15.0f)) & 0x0f;
+
+    const int changed = cutoff ^ mPrevCutoff;
+    if (changed & 0x007) {
+        mQueue.push(0, 0x15, static_cast<reSID::reg8>(cutoff & 0x007));
+    }
+    if (changed & 0x7f8) {
+        mQueue.push(0, 0x16, static_cast<reSID::reg8>(cutoff >> 3));
+    }
+    mPrevCutoff = cutoff;
+
+    const reSID::reg8 resFilt = static_cast<reSID::reg8>((resonance << 4) | filter);
+    if (resFilt != mPrevResFilt) {
+        mQueue.push(0, 0x17, resFilt);
+        mPrevResFilt = resFilt;
+    }
+    const reSID::reg8 modeVol = static_cast<reSID::reg8>((filterMode << 4) | volume);
+    if (modeVol != mPrevModeVol) {
+        mQueue.push(0, 0x18, modeVol);
+        mPrevModeVol = modeVol;
+    }
+}
+
+void SIDOscFull::queueEnvelope() {
+    reSID::reg8 attackDecay, sustainRelease;
+    readEnvelope(this, kInFullAttack, attackDecay, sustainRelease);
+    if (attackDecay != mPrevAttackDecay) {
         for (int v = 0; v < 3; v++) {
-            sumVoiceOutput += static_cast<float>(voice[v].wave.output() - voice[v].getWaveZero());
+            mQueue.push(0, v * 7 + 0x05, attackDecay);
         }
-        float mixedOutput = sumVoiceOutput / 3.0f;
-       
-        float finalOutput = (mixedOutput / kOutNorm * mGain);
-        outputBuffer[i] = finalOutput;
+        mPrevAttackDecay = attackDecay;
+    }
+    if (sustainRelease != mPrevSustainRelease) {
+        for (int v = 0; v < 3; v++) {
+            mQueue.push(0, v * 7 + 0x06, sustainRelease);
+        }
+        mPrevSustainRelease = sustainRelease;
     }
 }
 
+void SIDOscFull::next(int nSamples) {
+    SIDOSC_BLOCK(nSamples);
+    const float* freqInput   = in(0);
+    const bool  freqAudioRate = (inRate(0) == calc_FullRate);
+    mGain = in0(1);
+    const int   waveformType = static_cast<int>(in0(2));
+    const bool  currentGate  = (in0(4) > 0.5f);
+    const reSID::reg8 control = static_cast<reSID::reg8>((waveformType << 4) | (currentGate ? 0x01 : 0x00));
+
+    // Control-rate inputs are written at the start of the block. An audio-rate
+    // frequency is written at the cycle of each sample where its register
+    // value changes.
+    float* outputBuffer = this->out(0);
+    float peak = 0.0f;
+    for (int i = 0; i < nSamples; i += kSampleChunk) {
+        const int chunk = std::min(nSamples - i, kSampleChunk);
+
+        mQueue.clear();
+        if (i == 0) {
+            queueEnvelope();
+            queueControl(control, 0);
+            queueFilter();
+            queueFrequency(freqInput[0], 0);
+        }
+        if (freqAudioRate) {
+            for (int j = (i == 0) ? 1 : 0; j < chunk; ++j) {
+                queueFrequency(freqInput[i + j], (j * mCyclesPerSample) >> kFixpShift);
+            }
+        }
+
+        SIDOSC_COUNT(registerWrites, mQueue.size());
+        int produced;
+        {
+            SIDOSC_TIME(clockNanos);
+            produced = mQueue.render(sid, outputBuffer + i, chunk, mGain);
+        }
+        SIDOSC_COUNT(cycles, (static_cast<uint64_t>(produced) * mCyclesPerSample) >> kFixpShift);
+        SIDOSC_COUNT(convolutions, produced * mConvolutionsPerSample);
+        for (int j = 0; j < produced; ++j) {
+            peak = std::max(peak, std::abs(outputBuffer[i + j]));
+        }
+    }
+
+    // The chip keeps being clocked while silent, since the filter and the
+    // external filter have to settle; the node is only done once they have.
+    mGateSeen |= currentGate;
+    if (mGateSeen && !currentGate && !mDone && peak <= kSilenceLevel * std::abs(mGain) / 32768.0f && sid.voices_silent()) {
+        mDone = true;
+        DoneAction(static_cast<int>(getInputDefault(this, kInFullDoneAction, 0.0f)), this);
+    }
+}
+
+SID::State SIDOscFull::snapshotState() {
+    return sid.read_state();
+}
+
+void SIDOscFull::restoreState(const SID::State& state) {
+    sid.write_state(state);
+
+    // The voices share their registers, so voice 1 stands for all three.
+    const reSID::reg8* reg = reinterpret_cast<const reSID::reg8*>(state.sid_register);
+    freqValue = reg[0x00] | (reg[0x01] << 8);
+    mPrevControlReg = reg[0x04];
+    mPrevAttackDecay = reg[0x05];
+    mPrevSustainRelease = reg[0x06];
+    mPrevCutoff = (reg[0x15] & 0x007) | (reg[0x16] << 3);
+    mPrevResFilt = reg[0x17];
+    mPrevModeVol = reg[0x18];
+}
+
+// Snapshots are stored in a Buffer as a tagged copy of SID::State. The
+// contents are not audio, and only valid for the build that wrote them.
+struct StateSnapshot {
+    static constexpr uint32 kTag = 0x53494453; // "SIDS"
+    uint32 tag;
+    uint32 size;
+    SID::State state;
+};
+static_assert(std::is_trivially_copyable<StateSnapshot>::value, "snapshots are copied as raw memory");
+
+static SndBuf* snapshotBuffer(Unit* unit, sc_msg_iter* args) {
+    const int bufnum = args->geti(-1);
+    World* world = unit->mWorld;
+    if (bufnum < 0 || static_cast<uint32>(bufnum) >= world->mNumSndBufs) {
+        Print("SIDOscFull: invalid snapshot buffer %d\n", bufnum);
+        return nullptr;
+    }
+    SndBuf* buf = world->mSndBufs + bufnum;
+    if (!buf->data || buf->samples * sizeof(float) < sizeof(StateSnapshot)) {
+        Print("SIDOscFull: snapshot buffer %d needs at least %d samples\n", bufnum,
+              static_cast<int>((sizeof(StateSnapshot) + sizeof(float) - 1) / sizeof(float)));
+        return nullptr;
+    }
+    return buf;
+}
+
+// /u_cmd nodeID ugenIndex "snapshot" bufnum
+static void snapshotCmd(Unit* unit, sc_msg_iter* args) {
+    SndBuf* buf = snapshotBuffer(unit, args);
+    if (!buf) {
+        return;
+    }
+    StateSnapshot snapshot;
+    snapshot.tag = StateSnapshot::kTag;
+    snapshot.size = sizeof(SID::State);
+    snapshot.state = static_cast<SIDOscFull*>(unit)->snapshotState();
+    LOCK_SNDBUF(buf);
+    std::memcpy(buf->data, &snapshot, sizeof(snapshot));
+}
+
+// /u_cmd nodeID ugenIndex "restore" bufnum
+static void restoreCmd(Unit* unit, sc_msg_iter* args) {
+    SndBuf* buf = snapshotBuffer(unit, args);
+    if (!buf) {
+        return;
+    }
+    StateSnapshot snapshot;
+    {
+        LOCK_SNDBUF_SHARED(buf);
+        std::memcpy(static_cast<void*>(&snapshot), buf->data, sizeof(snapshot));
+    }
+    if (snapshot.tag != StateSnapshot::kTag || snapshot.size != sizeof(SID::State)) {
+        Print("SIDOscFull: buffer does not hold a snapshot\n");
+        return;
+    }
+    static_cast<SIDOscFull*>(unit)->restoreState(snapshot.state);
+}
+
+#if SIDOSC_INSTRUMENT
+// A float holds integers exactly up to 2^24, so each counter is sent as two
+// 24-bit words, hi * 2^24 + lo; that is exact up to 2^48.
+static void splitCounter(uint64_t value, float* words) {
+    words[0] = static_cast<float>((value >> 24) & 0xFFFFFF);
+    words[1] = static_cast<float>(value & 0xFFFFFF);
+}
+
+// /u_cmd nodeID ugenIndex "stats" [replyID]
+// Replies /sidosc_stats nodeID replyID followed by a hi, lo word pair for
+// each of calls samples cycles registerWrites convolutions clockMicros
+// nextMicros.
+template <class UnitType>
+static void statsCmd(Unit* unit, sc_msg_iter* args) {
+    const NodeStats& stats = static_cast<UnitType*>(unit)->stats();
+    const uint64_t counters[] = {
+        stats.calls,
+        stats.samples,
+        stats.cycles,
+        stats.registerWrites,
+        stats.convolutions,
+        stats.clockNanos / 1000,
+        stats.nextNanos / 1000,
+    };
+    constexpr int kNumCounters = sizeof(counters) / sizeof(counters[0]);
+    float values[2 * kNumCounters];
+    for (int i = 0; i < kNumCounters; i++) {
+        splitCounter(counters[i], values + 2 * i);
+    }
+    SendNodeReply(&unit->mParent->mNode, args->geti(-1), "/sidosc_stats", 2 * kNumCounters, values);
+}
+
+static void printStats(const char* name, const AggregateStats& totals) {
+    const double samples = static_cast<double>(totals.samples);
+    Print("%s: %llu nodes, %llu calls, %llu samples, %llu cycles, %llu register writes, %llu convolutions, "
+          "%.3f s in SID::clock, %.3f s in next (%.1f ns/sample)\n",
+          name,
+          static_cast<unsigned long long>(totals.nodes), static_cast<unsigned long long>(totals.calls),
+          static_cast<unsigned long long>(totals.samples), static_cast<unsigned long long>(totals.cycles),
+          static_cast<unsigned long long>(totals.registerWrites), static_cast<unsigned long long>(totals.convolutions),
+          totals.clockNanos * 1e-9, totals.nextNanos * 1e-9, samples > 0 ? totals.nextNanos / samples : 0.0);
+}
+#endif
+
 } // namespace SIDOsc
 PluginLoad(SIDOsc) {
     ft = inTable;
+    // Build the reSID waveform tables on the loading thread, so that node
+    // constructors on the audio threads never initialize shared state. The
+    // filter tables are constant data, generated when reSID is built.
+    reSID::WaveformGenerator::class_init();
+    SIDOsc::buildVoiceDac();
+    SIDOsc::buildMinBlep();
     registerUnit<SIDOsc::SIDOsc>(ft, "SIDOsc", false);
+    registerUnit<SIDOsc::SIDOscFull>(ft, "SIDOscFull", false);
+    DefineUnitCmd("SIDOscFull", "snapshot", SIDOsc::snapshotCmd);
+    DefineUnitCmd("SIDOscFull", "restore", SIDOsc::restoreCmd);
+#if SIDOSC_INSTRUMENT
+    DefineUnitCmd("SIDOsc", "stats", SIDOsc::statsCmd<SIDOsc::SIDOsc>);
+    DefineUnitCmd("SIDOscFull", "stats", SIDOsc::statsCmd<SIDOsc::SIDOscFull>);
+#endif
+    SIDOsc::configureRenderPool();
+    registerUnit<SIDOsc::SIDBank>(ft, "SIDBank", false);
+    registerUnit<SIDOsc::SIDPlayer>(ft, "SIDPlayer", false);
+    SIDOsc::definePrepareCmd();
+}
+
+PluginUnload(SIDOsc) {
+    SIDOsc::stopRenderPool();
+    if (const uint64_t misses = SIDOsc::renderMisses()) {
+        Print("SIDBank: %llu blocks repeated while a render worker was late\n",
+              static_cast<unsigned long long>(misses));
+    }
+#if SIDOSC_INSTRUMENT
+    // Totals of the nodes freed so far.
+    SIDOsc::printStats("SIDOsc", SIDOsc::sidOscTotals);
+    SIDOsc::printStats("SIDOscFull", SIDOsc::sidOscFullTotals);
+#endif
 }
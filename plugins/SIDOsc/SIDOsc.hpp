@@ -10,47 +10,99 @@
 #include "extfilt.h"
 #include "pot.h"
 #include "envelope.h"
+#include "RegisterQueue.hpp"
+#include "Instrumentation.hpp"
+#include "MinBlep.hpp"
 #include <vector>
 #include <array>
 #include <algorithm>
+#include <cstdint>
 
 namespace SIDOsc {
 
+// Lean variant: three standalone voices and nothing else. There is no filter,
+// no external filter and no resampler, so construction is cheap.
 class SIDOsc : public SCUnit {
 public:
     SIDOsc();
     ~SIDOsc() = default;
 
-    // SID-specific operations.
-    reSID::reg8 readRegister(reSID::reg8 offset);
-    void writeRegister(reSID::reg8 offset, reSID::reg8 value);
-    //commout
-//    void configureFilter(bool enable, double bias);
-    void setSamplingParameters(double clockFreq = 985248.0, double sampleFreq = 44100.0);
+#if SIDOSC_INSTRUMENT
+    const NodeStats& stats() const { return mStats; }
+#endif
 
 private:
+    // Legacy path: the voices are clocked one SID cycle per sample.
     void next(int nSamples);
+    // Delta-clocked path: the voices are clocked at kClockFreq, picking the
+    // nearest cycle for each sample as SID::clock_fast() does.
+    void next_delta(int nSamples);
+    // Delta-clocked path for an audio-rate frequency input.
+    void next_delta_ar(int nSamples);
+
+    // Delta-clocked path for a scalar waveform input. The control register
+    // never sets SYNC, RING or TEST, so with the waveform and chip model known
+    // at compile time the oscillator reduces to an accumulator add and the
+    // waveform selection, sync and table lookups drop out.
+    template <int Waveform, reSID::chip_model Model>
+    void next_fixed(int nSamples);
+    // The next_fixed kernel for a waveform and chip model, or nullptr.
+    static UnitCalcFunc fixedCalcFunction(int waveformType, reSID::chip_model model);
+
+    // Band-limited path: the accumulators advance by the exact phase
+    // increment of a sample instead of whole cycles, and the sawtooth and
+    // pulse edges between samples are corrected with minBLEP residuals.
+    void next_blep(int nSamples);
+
+    // Advance the voices to the next sample and return the mixed output.
+    // With envelopesHeld the envelopes are not clocked; their cycles are
+    // accumulated and handed over in one call by clockHeldEnvelopes().
+    int clockSample(bool envelopesHeld);
+    template <int Waveform, reSID::chip_model Model>
+    int clockSampleFixed(bool envelopesHeld);
+    // Band-limited sample; the voices go to voiceOutput, the mix is returned.
+    float clockSampleBlep(bool envelopesHeld, float* voiceOutput);
+    // Centred DAC level of a voice at waveform table index ix.
+    int blepLevel(const reSID::WaveformGenerator& wave, int ix) const;
+    void addBlep(int v, float delay, float step);
+    reSID::cycle_count nextDeltaT();
+    // Store the mixed sample, or with three outputs each voice on its own.
+    void storeSample(int i, int sum, float scale);
+    bool envelopesHeld();
+    void clockHeldEnvelopes();
+    // Render a block of silence if all voices are silent; see the definition.
+    bool renderIdle(int nSamples, bool gate);
+
+    void writeFrequency(float freq);
+    void writeControl(reSID::reg8 control);
+    void writeEnvelope();
 
     // Control-rate gain parameter.
     float mGain;
 
     // Three voices (to emulate a full SID).
     reSID::Voice voice[3];
-    
-    //commout
-    // Filter and external filter.
-//    reSID::Filter filter;
-//    reSID::ExternalFilter extFilter;
 
-    // Potentiometer instances.
-    reSID::Potentiometer potX, potY;
+    // Enveloped voice outputs of the last clockSample(), for the per-voice
+    // output mode.
+    int mVoiceOutput[3];
 
-    // Static DAC models.
-    static const reSID::DAC<12> dac6581; // For 6581
-    static const reSID::DAC<12> dac8580; // For 8580
+    // Centred waveform D/A table of the chip model.
+    const short* mVoiceDac;
 
-    // An instance of the full SID 
-    reSID::SID sid;
+    // Band-limited path: fractional accumulator bits below the 24 of the
+    // register (kFixpShift bits), and per voice a ring of pending minBLEP
+    // residuals, the current sample at mBlepIndex.
+    uint32_t mPhaseFraction[3];
+    float mBlepBuffer[3][kMinBlepTaps];
+    int mBlepIndex;
+
+    // 16.16 fixed point cycles per sample, and the fractional remainder.
+    reSID::cycle_count mCyclesPerSample;
+    reSID::cycle_count mSampleOffset;
+
+    // Audio-rate frequency is converted to accumulator increments in chunks.
+    static constexpr int kFreqChunk = 64;
 
     // Persistent frequency register value.
     volatile unsigned int freqValue;
@@ -58,13 +110,97 @@ private:
     // Cache for the previous control register.
     reSID::reg8 mPrevControlReg;
     
-    // Persistent previous frequency.
-    float mPrevFreq;
-    
-    // Cache for the previous gate value and envelope parameter values.
+    // Cache for the previous gate value.
     bool mPrevGate;
-    //commout
-//    float mPrevAttackInput, mPrevDecayInput, mPrevSustainInput, mPrevReleaseInput;
+
+    // Caches for the previous envelope registers.
+    reSID::reg8 mPrevAttackDecay;
+    reSID::reg8 mPrevSustainRelease;
+
+    // Cycles the held envelopes are behind the voices.
+    reSID::cycle_count mHeldEnvelopeCycles;
+
+    // The gate has been on; doneAction only applies after that.
+    bool mGateSeen;
+
+#if SIDOSC_INSTRUMENT
+    NodeStats mStats{ sidOscTotals };
+#endif
+};
+
+// Full variant: a complete reSID::SID including filter, external filter and
+// the selectable reSID sampling methods.
+class SIDOscFull : public SCUnit {
+public:
+    SIDOscFull();
+    ~SIDOscFull() = default;
+
+#if SIDOSC_INSTRUMENT
+    const NodeStats& stats() const { return mStats; }
+#endif
+
+    // Set up the sampling method of the node for a sample rate. FIR tables
+    // come from the shared reSID cache, and the resampling ring buffer is
+    // only reallocated when it has to grow, so reconfiguring is cheap.
+    void setSamplingParameters(double sampleFreq);
+
+    // Complete chip state, including the filter integrators. A restored node
+    // continues from the snapshot, with its inputs applied from the next
+    // block on where they differ from the restored registers.
+    reSID::SID::State snapshotState();
+    void restoreState(const reSID::SID::State& state);
+
+private:
+    // The embedded SID is delta clocked at kClockFreq and sampled with the
+    // selected reSID sampling method.
+    void next(int nSamples);
+
+    // Queue register writes for values that differ from the last ones queued.
+    void queueFrequency(float freq, reSID::cycle_count cycle);
+    void queueControl(reSID::reg8 control, reSID::cycle_count cycle);
+    void queueFilter();
+    void queueEnvelope();
+
+    // Control-rate gain parameter.
+    float mGain;
+
+    reSID::SID sid;
+
+    // Blocks are rendered in chunks of this size, one register queue each.
+    static constexpr int kSampleChunk = RegisterQueue::kChunkSamples;
+
+    // Register writes for the chunk being rendered.
+    RegisterQueue mQueue;
+
+    // 16.16 fixed point cycles per sample, for write timestamps.
+    reSID::cycle_count mCyclesPerSample;
+
+    // Sampling method from the sampling input.
+    reSID::sampling_method mSampling;
+
+    // Persistent frequency register value.
+    unsigned int freqValue;
+
+    // Cache for the previous control register.
+    reSID::reg8 mPrevControlReg;
+
+    // Caches for the previous filter register values.
+    int mPrevCutoff;
+    reSID::reg8 mPrevResFilt;
+    reSID::reg8 mPrevModeVol;
+
+    // Caches for the previous envelope registers.
+    reSID::reg8 mPrevAttackDecay;
+    reSID::reg8 mPrevSustainRelease;
+
+    // The gate has been on; doneAction only applies after that.
+    bool mGateSeen;
+
+#if SIDOSC_INSTRUMENT
+    NodeStats mStats{ sidOscFullTotals };
+    // FIR convolutions per sample of the sampling method in use.
+    int mConvolutionsPerSample;
+#endif
 };
 
 } // namespace SIDOsc
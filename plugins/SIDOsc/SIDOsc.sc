@@ -1,11 +1,43 @@
-SIDOsc : UGen {
-    *ar { |freq = 440, gain = 1.0|
-        // Create an audio-rate instance with two parameters:
-        // frequency and gain
-        ^this.multiNew('audio', freq, gain);
+SIDOsc : MultiOutUGen {
+    *ar { |freq = 440, gain = 1.0, waveform = 2, dacType = 0, gate = 1, sampling = 0,
+        attack = 0, decay = 0, sustain = 15, release = 0, doneAction = 0, numChannels = 1|
+        // Create an audio-rate instance. Lean variant: voices only, no filter.
+        // waveform: SID control register bits 7-4 (1 = triangle, 2 = sawtooth, 4 = pulse, 8 = noise)
+        // dacType: 0 = MOS6581, 1 = MOS8580
+        // sampling: -1 = legacy per-sample clocking, 0 = delta clocking at the SID clock rate,
+        //   1 = exact phase with band-limited (minBLEP) sawtooth and pulse edges
+        // attack, decay, sustain, release: SID envelope registers (0-15), not with sampling -1
+        // doneAction: applied when the voices are silent after the gate went off
+        // numChannels: 1 = mixed output, 3 = one output per voice
+        ^this.multiNew('audio', if(numChannels == 3, 3, 1), freq, gain, waveform, dacType, gate, sampling,
+            attack, decay, sustain, release, doneAction);
+    }
+    init { arg argNumChannels ... theInputs;
+        inputs = theInputs;
+        ^this.initOutputs(argNumChannels, rate);
     }
     checkInputs {
         // Ensures the inputs are valid (like non-negative freq, etc.)
         ^this.checkValidInputs;
     }
 }
+
+SIDOscFull : UGen {
+    *ar { |freq = 440, gain = 1.0, waveform = 2, dacType = 0, gate = 1, sampling = 0,
+        cutoff = 2047, resonance = 0, filter = 0, filterMode = 0, volume = 15,
+        attack = 0, decay = 0, sustain = 15, release = 0, doneAction = 0|
+        // Full reSID chip, including filter and external filter.
+        // sampling: 0 = fast, 1 = interpolate, 2 = resample, 3 = resample fastmem
+        // cutoff (0-2047), resonance (0-15), volume (0-15): SID filter and volume registers
+        // filter: voices routed through the filter (1, 2, 4 = voices 1-3, 8 = external input)
+        // filterMode: 1 = low pass, 2 = band pass, 4 = high pass, 8 = voice 3 off
+        // attack, decay, sustain, release: SID envelope registers (0-15)
+        // doneAction: applied when the chip is silent after the gate went off
+        ^this.multiNew('audio', freq, gain, waveform, dacType, gate, sampling,
+            cutoff, resonance, filter, filterMode, volume,
+            attack, decay, sustain, release, doneAction);
+    }
+    checkInputs {
+        ^this.checkValidInputs;
+    }
+}
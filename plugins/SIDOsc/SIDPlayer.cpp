@@ -0,0 +1,92 @@
+#include "SIDPlayer.hpp"
+#include "FirTables.hpp"
+#include "SIDDefs.hpp"
+#include <algorithm>
+
+using namespace reSID;
+
+extern InterfaceTable* ft;
+
+namespace SIDOsc {
+
+// Input indices. The buffer number must be input 0 for GET_BUF_SHARED.
+static constexpr int kInBufnum     = 0;
+static constexpr int kInGain       = 1;
+static constexpr int kInDacType    = 2;
+static constexpr int kInSampling   = 3; // reSID sampling_method, 0-3
+static constexpr int kInLoop       = 4;
+static constexpr int kInDoneAction = 5;
+
+// Values per register write in the buffer: cycle delta, address, value.
+static constexpr int kWriteSize = 3;
+// Longest cycle delta between writes, about 17 s.
+static constexpr float kMaxCycleDelta = 16777216.0f;
+
+SIDPlayer::SIDPlayer()
+    : m_fbufnum(-1.0f)
+    , m_buf(nullptr)
+    , mPosition(0)
+    , mCyclesToWrite(-1)
+    , mClockedSinceLoop(false)
+{
+    sid.set_chip_model(static_cast<int>(in0(kInDacType)) == 1 ? MOS8580 : MOS6581);
+    sid.set_allocator(rtAllocHook, rtFreeHook, mWorld);
+
+    const int sampling = std::max(0, static_cast<int>(in0(kInSampling)));
+    const sampling_method method = static_cast<sampling_method>(std::min(sampling, static_cast<int>(SAMPLE_RESAMPLE_FASTMEM)));
+    setUnitSampling(this, sid, kClockFreq, method, sampleRate(), "SIDPlayer");
+
+    mCalcFunc = make_calc_function<SIDPlayer, &SIDPlayer::next>();
+    next(1);
+}
+
+// Writes that are due are applied, then the SID is delta clocked up to the
+// next write or the end of the block, whichever comes first. Once the stream
+// has ended the chip keeps running, so that the last notes ring out; the
+// doneAction only applies to a stream that does not loop.
+void SIDPlayer::next(int nSamples) {
+    SIDPlayer* unit = this;
+    GET_BUF_SHARED
+    const float gain = in0(kInGain);
+    const bool loop = in0(kInLoop) > 0.5f;
+    const uint32 numWrites = bufData ? (bufFrames * bufChannels) / kWriteSize : 0;
+
+    float* outputBuffer = out(0);
+    int produced = 0;
+    while (produced < nSamples) {
+        while (mPosition < numWrites) {
+            const float* write = bufData + mPosition * kWriteSize;
+            if (mCyclesToWrite < 0) {
+                mCyclesToWrite = static_cast<cycle_count>(std::min(std::max(write[0], 0.0f), kMaxCycleDelta));
+            }
+            if (mCyclesToWrite > 0) {
+                break;
+            }
+            sid.write(static_cast<reg8>(static_cast<int>(write[1]) & 0x1f), static_cast<reg8>(static_cast<int>(write[2]) & 0xff));
+            mCyclesToWrite = -1;
+            if (++mPosition == numWrites && loop && mClockedSinceLoop) {
+                mPosition = 0;
+                mClockedSinceLoop = false;
+            }
+        }
+
+        if (mPosition >= numWrites) {
+            produced += sid.clock(outputBuffer + produced, nSamples - produced, gain);
+            if (loop && numWrites) {
+                // A looped stream without any cycle delta: the rest of the
+                // block plays, and the writes start over on the next one.
+                mPosition = 0;
+                mClockedSinceLoop = false;
+            } else if (!mDone && numWrites) {
+                mDone = true;
+                DoneAction(static_cast<int>(in0(kInDoneAction)), this);
+            }
+            break;
+        }
+
+        produced += sid.clock(mCyclesToWrite, outputBuffer + produced, nSamples - produced, gain);
+        mClockedSinceLoop = true;
+    }
+}
+
+} // namespace SIDOsc
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "SC_PlugIn.hpp"
+#include "sid.h"
+
+namespace SIDOsc {
+
+// Register stream player: a complete reSID::SID driven by register writes
+// read from a Buffer instead of from UGen inputs.
+//
+// The buffer holds (cycle delta, address, value) triples, in frame order and
+// regardless of the number of channels. Each write is applied after the SID
+// has been clocked for its cycle delta since the previous write, so that a
+// captured register log replays with cycle accuracy and no 6502 emulation.
+class SIDPlayer : public SCUnit {
+public:
+    SIDPlayer();
+    ~SIDPlayer() = default;
+
+    // Buffer lookup state for GET_BUF_SHARED.
+    float m_fbufnum;
+    SndBuf* m_buf;
+
+private:
+    void next(int nSamples);
+
+    reSID::SID sid;
+
+    // Index of the next write, and the cycles left until it is due.
+    // mCyclesToWrite < 0: the cycle delta of the next write is not read yet.
+    uint32 mPosition;
+    reSID::cycle_count mCyclesToWrite;
+
+    // The chip has been clocked since the stream last started over; a loop
+    // of writes without any cycle delta would never produce a sample.
+    bool mClockedSinceLoop;
+};
+
+} // namespace SIDOsc
@@ -0,0 +1,12 @@
+SIDPlayer : UGen {
+    *ar { |bufnum = 0, gain = 1.0, dacType = 0, sampling = 0, loop = 0, doneAction = 0|
+        // Plays a SID register stream: (cycle delta, address, value) triples read from a Buffer.
+        // dacType: 0 = MOS6581, 1 = MOS8580
+        // sampling: 0 = fast, 1 = interpolate, 2 = resample, 3 = resample fastmem
+        // doneAction: applied when the end of the stream is reached
+        ^this.multiNew('audio', bufnum, gain, dacType, sampling, loop, doneAction);
+    }
+    checkInputs {
+        ^this.checkValidInputs;
+    }
+}
@@ -56,6 +56,13 @@ public:
   // 8-bit envelope output.
   short output();
 
+  // Whether output() stays constant until the next register write, i.e. the
+  // envelope counter is held at the sustain level or frozen at zero.
+  bool held();
+  // Whether the envelope counter is frozen at zero, i.e. the output is zero
+  // until the next register write.
+  bool silent();
+
 protected:
   void set_exponential_counter();
 
@@ -283,6 +290,24 @@ void EnvelopeGenerator::clock(cycle_count delta_t)
 }
 
 
+// ----------------------------------------------------------------------------
+// Check whether the envelope counter can change without a register write.
+// ----------------------------------------------------------------------------
+RESID_INLINE
+bool EnvelopeGenerator::held()
+{
+  return hold_zero ||
+    (state == DECAY_SUSTAIN && envelope_counter == sustain_level[sustain]);
+}
+
+
+RESID_INLINE
+bool EnvelopeGenerator::silent()
+{
+  return hold_zero;
+}
+
+
 // ----------------------------------------------------------------------------
 // Read the envelope generator output.
 // ----------------------------------------------------------------------------
@@ -417,6 +417,13 @@ protected:
 
   chip_model sid_model;
 
+#if RESID_COMPACT_TABLES
+  // The gain tables are stored as every 64th entry; see gain_lookup().
+  enum { gain_shift = 6 };
+#else
+  enum { gain_shift = 0 };
+#endif
+
   typedef struct {
     int vo_N16;  // Fixed point scaling for 16 bit op-amp output.
     int kVddt;   // K*(Vdd - Vth)
@@ -432,20 +439,28 @@ protected:
     unsigned short opamp_rev[1 << 16];
     // Lookup tables for gain and summer op-amps in output stage / filter.
     unsigned short summer[summer_offset<5>::value];
+#if RESID_COMPACT_TABLES
+    unsigned short gain[16][(1 << (16 - gain_shift)) + 1];
+#else
     unsigned short gain[16][1 << 16];
+#endif
     unsigned short mixer[mixer_offset<8>::value];
     // Cutoff frequency DAC output voltage table. FC is an 11 bit register.
-    DAC<11> f0_dac;
+    unsigned short f0_dac[1 << 11];
   } model_filter_t;
 
-  int solve_gain(int* opamp, int n, int vi_t, int& x, model_filter_t& mf);
-  int solve_integrate_6581(int dt, int vi_t, int& x, int& vc, model_filter_t& mf);
+  static int solve_gain(int* opamp, int n, int vi_t, int& x, const model_filter_t& mf);
+  static int gain_lookup(const model_filter_t& mf, int n, int vi);
+  int solve_integrate_6581(int dt, int vi_t, int& x, int& vc, const model_filter_t& mf);
+
+  // The model tables below are constant data, calculated when reSID is
+  // built; see filter_gen.cc.
 
   // VCR - 6581 only.
-  static unsigned short vcr_kVg[1 << 16];
-  static unsigned short vcr_n_Ids_term[1 << 16];
+  static const unsigned short vcr_kVg[1 << 16];
+  static const unsigned short vcr_n_Ids_term[1 << 16];
   // Common parameters.
-  static model_filter_t model_filter[2];
+  static const model_filter_t model_filter[2];
 
 friend class SID;
 };
@@ -459,13 +474,36 @@ friend class SID;
 
 #if RESID_INLINING || defined(RESID_FILTER_CC)
 
+// ----------------------------------------------------------------------------
+// Gain op-amp lookup.
+// The exact tables take 2MB per chip model. The compact tables instead hold
+// every 64th entry, 33kB per chip model, and interpolate linearly in between.
+// The transfer functions are smooth, and the interpolated values stay within
+// 5 LSB (of 16 bits) of the exact tables; most of that difference is the
+// rounding noise of the iterative solver that builds them.
+// ----------------------------------------------------------------------------
+RESID_INLINE
+int Filter::gain_lookup(const model_filter_t& mf, int n, int vi)
+{
+#if RESID_COMPACT_TABLES
+  const unsigned short* gain = mf.gain[n];
+  int j = vi >> gain_shift;
+  int a = gain[j];
+  int b = gain[j + 1];
+  return a + ((b - a)*(vi & ((1 << gain_shift) - 1)) >> gain_shift);
+#else
+  return mf.gain[n][vi];
+#endif
+}
+
+
 // ----------------------------------------------------------------------------
 // SID clocking - 1 cycle.
 // ----------------------------------------------------------------------------
 RESID_INLINE
 void Filter::clock(int voice1, int voice2, int voice3)
 {
-  model_filter_t& f = model_filter[sid_model];
+  const model_filter_t& f = model_filter[sid_model];
 
   v1 = (voice1*f.voice_scale_s14 >> 18) + f.voice_DC;
   v2 = (voice2*f.voice_scale_s14 >> 18) + f.voice_DC;
@@ -547,7 +585,7 @@ void Filter::clock(int voice1, int voice2, int voice3)
     // MOS 6581.
     Vlp = solve_integrate_6581(1, Vbp, Vlp_x, Vlp_vc, f);
     Vbp = solve_integrate_6581(1, Vhp, Vbp_x, Vbp_vc, f);
-    Vhp = f.summer[offset + f.gain[_8_div_Q][Vbp] + Vlp + Vi];
+    Vhp = f.summer[offset + gain_lookup(f, _8_div_Q, Vbp) + Vlp + Vi];
   }
   else {
     // MOS 8580. FIXME: Not yet using op-amp model.
@@ -569,7 +607,7 @@ void Filter::clock(int voice1, int voice2, int voice3)
 RESID_INLINE
 void Filter::clock(cycle_count delta_t, int voice1, int voice2, int voice3)
 {
-  model_filter_t& f = model_filter[sid_model];
+  const model_filter_t& f = model_filter[sid_model];
 
   v1 = (voice1*f.voice_scale_s14 >> 18) + f.voice_DC;
   v2 = (voice2*f.voice_scale_s14 >> 18) + f.voice_DC;
@@ -668,7 +706,7 @@ void Filter::clock(cycle_count delta_t, int voice1, int voice2, int voice3)
       // Calculate filter outputs.
       Vlp = solve_integrate_6581(delta_t_flt, Vbp, Vlp_x, Vlp_vc, f);
       Vbp = solve_integrate_6581(delta_t_flt, Vhp, Vbp_x, Vbp_vc, f);
-      Vhp = f.summer[offset + f.gain[_8_div_Q][Vbp] + Vlp + Vi];
+      Vhp = f.summer[offset + gain_lookup(f, _8_div_Q, Vbp) + Vlp + Vi];
 
       delta_t -= delta_t_flt;
     }
@@ -714,7 +752,7 @@ void Filter::input(short sample)
   // The upside is that the MOS8580 "digi boost" works without a separate (DC)
   // input interface.
   // Note that the input is 16 bits, compared to the 20 bit voice output.
-  model_filter_t& f = model_filter[sid_model];
+  const model_filter_t& f = model_filter[sid_model];
   ve = (sample*f.voice_scale_s14*3 >> 14) + f.mixer[0];
 }
 
@@ -725,7 +763,7 @@ void Filter::input(short sample)
 RESID_INLINE
 short Filter::output()
 {
-  model_filter_t& f = model_filter[sid_model];
+  const model_filter_t& f = model_filter[sid_model];
 
   // Writing the switch below manually would be tedious and error-prone;
   // it is rather generated by the following Perl program:
@@ -1267,7 +1305,7 @@ for my $mix (0..2**@i-1) {
 
   // Sum the inputs in the mixer and run the mixer output through the gain.
   if (sid_model == MOS6581) {
-    return (short)(f.gain[vol][f.mixer[offset + Vi]] - (1 << 15));
+    return (short)(gain_lookup(f, vol, f.mixer[offset + Vi]) - (1 << 15));
   }
   else {
     // FIXME: Temporary code for MOS 8580, should use code above.
@@ -1315,7 +1353,7 @@ the equations for the root function and its derivative can be written as:
   df = 2*((b - (vx + x))*(dvx + 1) - a*(b - vx)*dvx)
 */
 RESID_INLINE
-int Filter::solve_gain(int* opamp, int n, int vi, int& x, model_filter_t& mf)
+int Filter::solve_gain(int* opamp, int n, int vi, int& x, const model_filter_t& mf)
 {
   // Note that all variables are translated and scaled in order to fit
   // in 16 bits. It is not necessary to explicitly translate the variables here,
@@ -1510,7 +1548,7 @@ Vg = Vddt - sqrt(((Vddt - vi)^2 + (Vddt - Vw)^2)/2)
 */
 RESID_INLINE
 int Filter::solve_integrate_6581(int dt, int vi, int& vx, int& vc,
-				 model_filter_t& mf)
+				 const model_filter_t& mf)
 {
   // Note that all variables are translated and scaled in order to fit
   // in 16 bits. It is not necessary to explicitly translate the variables here,
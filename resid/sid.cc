@@ -21,6 +21,22 @@
 
 #include "sid.h"
 #include <math.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RESID_FIR_SSE2 1
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RESID_FIR_AVX2 1
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define RESID_FIR_NEON 1
+#endif
 
 #ifndef round
 #define round(x) (x>=0.0?floor(x+0.5):ceil(x-0.5))
@@ -29,6 +45,20 @@
 namespace reSID
 {
 
+// ----------------------------------------------------------------------------
+// Default memory hooks.
+// ----------------------------------------------------------------------------
+static void* default_alloc(void*, std::size_t size)
+{
+  return ::operator new(size, std::nothrow);
+}
+
+static void default_free(void*, void* ptr)
+{
+  ::operator delete(ptr);
+}
+
+
 // ----------------------------------------------------------------------------
 // Constructor.
 // ----------------------------------------------------------------------------
@@ -36,7 +66,16 @@ SID::SID()
 {
   // Initialize pointers.
   sample = 0;
+  ring_size = 0;
+  ring_mask = 0;
+  sample_capacity = 0;
+  fir_table = 0;
   fir = 0;
+  fir_build = true;
+
+  mem_alloc = default_alloc;
+  mem_free = default_free;
+  mem_context = 0;
 
   sid_model = MOS6581;
   voice[0].set_sync_source(&voice[2]);
@@ -60,8 +99,53 @@ SID::SID()
 // ----------------------------------------------------------------------------
 SID::~SID()
 {
-  delete[] sample;
-  delete[] fir;
+  free_resampling_buffers();
+}
+
+
+// ----------------------------------------------------------------------------
+// Set memory hooks.
+// The hooks are used for all subsequent allocations of resampling buffers,
+// e.g. to use a real-time memory pool. Buffers allocated with the previous
+// hooks are released, and a resampling method falls back to SAMPLE_FAST;
+// call set_sampling_parameters() again to reallocate them.
+// ----------------------------------------------------------------------------
+void SID::set_allocator(alloc_func alloc, free_func free, void* context)
+{
+  free_resampling_buffers();
+  if (sampling == SAMPLE_RESAMPLE || sampling == SAMPLE_RESAMPLE_FASTMEM) {
+    sampling = SAMPLE_FAST;
+  }
+
+  mem_alloc = alloc ? alloc : default_alloc;
+  mem_free = free ? free : default_free;
+  mem_context = context;
+}
+
+
+// ----------------------------------------------------------------------------
+// Allocation of the sample ring buffer through the memory hooks.
+// ----------------------------------------------------------------------------
+short* SID::alloc_samples(int n)
+{
+  return static_cast<short*>(mem_alloc(mem_context, n*sizeof(short)));
+}
+
+void SID::free_samples(short* ptr)
+{
+  if (ptr) {
+    mem_free(mem_context, ptr);
+  }
+}
+
+void SID::free_resampling_buffers()
+{
+  free_samples(sample);
+  release_fir_table(fir_table);
+  sample = 0;
+  sample_capacity = 0;
+  fir_table = 0;
+  fir = 0;
 }
 
 
@@ -168,6 +252,12 @@ reg8 SID::read(reg8 offset)
 // ----------------------------------------------------------------------------
 void SID::write(reg8 offset, reg8 value)
 {
+  // Flush a pending pipelined write, so that several writes between two
+  // clock() calls are not collapsed into the last one.
+  if (unlikely(write_pipeline)) {
+    write();
+  }
+
   write_address = offset;
   bus_value = value;
   bus_value_ttl = databus_ttl;
@@ -298,6 +388,9 @@ SID::State::State()
     shift_pipeline[i] = 0;
     pulse_output[i] = 0;
     floating_output_ttl[i] = 0;
+    waveform_output[i] = 0;
+    osc3[i] = 0;
+    tri_saw_pipeline[i] = 0x555;
 
     rate_counter[i] = 0;
     rate_counter_period[i] = 9;
@@ -308,6 +401,12 @@ SID::State::State()
     hold_zero[i] = true;
     envelope_pipeline[i] = 0;
   }
+
+  filter_Vhp = 0;
+  filter_Vbp = filter_Vbp_x = filter_Vbp_vc = 0;
+  filter_Vlp = filter_Vlp_x = filter_Vlp_vc = 0;
+  extfilt_vlp = 0;
+  extfilt_vhp = 0;
 }
 
 
@@ -362,6 +461,9 @@ SID::State SID::read_state()
     state.shift_pipeline[i] = voice[i].wave.shift_pipeline;
     state.pulse_output[i] = voice[i].wave.pulse_output;
     state.floating_output_ttl[i] = voice[i].wave.floating_output_ttl;
+    state.waveform_output[i] = voice[i].wave.waveform_output;
+    state.osc3[i] = voice[i].wave.osc3;
+    state.tri_saw_pipeline[i] = voice[i].wave.tri_saw_pipeline;
 
     state.rate_counter[i] = voice[i].envelope.rate_counter;
     state.rate_counter_period[i] = voice[i].envelope.rate_period;
@@ -373,6 +475,16 @@ SID::State SID::read_state()
     state.envelope_pipeline[i] = voice[i].envelope.envelope_pipeline;
   }
 
+  state.filter_Vhp = filter.Vhp;
+  state.filter_Vbp = filter.Vbp;
+  state.filter_Vbp_x = filter.Vbp_x;
+  state.filter_Vbp_vc = filter.Vbp_vc;
+  state.filter_Vlp = filter.Vlp;
+  state.filter_Vlp_x = filter.Vlp_x;
+  state.filter_Vlp_vc = filter.Vlp_vc;
+  state.extfilt_vlp = extfilt.vlp;
+  state.extfilt_vhp = extfilt.vhp;
+
   return state;
 }
 
@@ -388,6 +500,12 @@ void SID::write_state(const State& state)
     write(i, state.sid_register[i]);
   }
 
+  // Flush the last write if it was pipelined, before the pipeline state is
+  // overwritten.
+  if (write_pipeline) {
+    write();
+  }
+
   bus_value = state.bus_value;
   bus_value_ttl = state.bus_value_ttl;
   write_pipeline = state.write_pipeline;
@@ -398,9 +516,13 @@ void SID::write_state(const State& state)
     voice[i].wave.accumulator = state.accumulator[i];
     voice[i].wave.shift_register = state.shift_register[i];
     voice[i].wave.shift_register_reset = state.shift_register_reset[i];
+    voice[i].wave.set_noise_output();
     voice[i].wave.shift_pipeline = state.shift_pipeline[i];
     voice[i].wave.pulse_output = state.pulse_output[i];
     voice[i].wave.floating_output_ttl = state.floating_output_ttl[i];
+    voice[i].wave.waveform_output = state.waveform_output[i];
+    voice[i].wave.osc3 = state.osc3[i];
+    voice[i].wave.tri_saw_pipeline = state.tri_saw_pipeline[i];
 
     voice[i].envelope.rate_counter = state.rate_counter[i];
     voice[i].envelope.rate_period = state.rate_counter_period[i];
@@ -411,6 +533,16 @@ void SID::write_state(const State& state)
     voice[i].envelope.hold_zero = state.hold_zero[i];
     voice[i].envelope.envelope_pipeline = state.envelope_pipeline[i];
   }
+
+  filter.Vhp = state.filter_Vhp;
+  filter.Vbp = state.filter_Vbp;
+  filter.Vbp_x = state.filter_Vbp_x;
+  filter.Vbp_vc = state.filter_Vbp_vc;
+  filter.Vlp = state.filter_Vlp;
+  filter.Vlp_x = state.filter_Vlp_x;
+  filter.Vlp_vc = state.filter_Vlp_vc;
+  extfilt.vlp = state.extfilt_vlp;
+  extfilt.vhp = state.extfilt_vhp;
 }
 
 
@@ -434,6 +566,17 @@ void SID::enable_filter(bool enable)
 }
 
 
+// ----------------------------------------------------------------------------
+// Check whether the voices are silent. The filter and the external filter
+// may still be settling.
+// ----------------------------------------------------------------------------
+bool SID::voices_silent()
+{
+  return voice[0].envelope.silent() && voice[1].envelope.silent() &&
+    voice[2].envelope.silent();
+}
+
+
 // ----------------------------------------------------------------------------
 // Adjust the DAC bias parameter of the filter.
 // This gives user variable control of the exact CF -> center frequency
@@ -479,6 +622,335 @@ double SID::I0(double x)
 }
 
 
+// ----------------------------------------------------------------------------
+// FIR convolution kernels.
+//
+// The convolutions in clock_resample() and clock_resample_fastmem() are
+// 16x16->32 bit dot products over fir_N taps. The SIMD kernels below use
+// pairwise multiply-add instructions (pmaddwd / vmlal) and yield the same
+// results as the scalar kernel. The best kernel supported by the CPU is
+// selected once at load time.
+// ----------------------------------------------------------------------------
+typedef int (*fir_kernel_func)(const short* sample, const short* fir, int n);
+
+#if !RESID_FIR_SSE2 && !RESID_FIR_NEON
+static int convolve_scalar(const short* sample, const short* fir, int n)
+{
+  int v = 0;
+  for (int j = 0; j < n; j++) {
+    v += sample[j]*fir[j];
+  }
+  return v;
+}
+#endif
+
+#if RESID_FIR_SSE2
+static int convolve_sse2(const short* sample, const short* fir, int n)
+{
+  __m128i acc = _mm_setzero_si128();
+  int j = 0;
+  for (; j + 8 <= n; j += 8) {
+    __m128i s = _mm_loadu_si128((const __m128i*)(sample + j));
+    __m128i f = _mm_loadu_si128((const __m128i*)(fir + j));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(s, f));
+  }
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+  int v = _mm_cvtsi128_si32(acc);
+  for (; j < n; j++) {
+    v += sample[j]*fir[j];
+  }
+  return v;
+}
+#endif
+
+#if RESID_FIR_AVX2
+__attribute__((target("avx2")))
+static int convolve_avx2(const short* sample, const short* fir, int n)
+{
+  __m256i acc = _mm256_setzero_si256();
+  int j = 0;
+  for (; j + 16 <= n; j += 16) {
+    __m256i s = _mm256_loadu_si256((const __m256i*)(sample + j));
+    __m256i f = _mm256_loadu_si256((const __m256i*)(fir + j));
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(s, f));
+  }
+  __m128i acc128 = _mm_add_epi32(_mm256_castsi256_si128(acc),
+				 _mm256_extracti128_si256(acc, 1));
+  acc128 = _mm_add_epi32(acc128, _mm_shuffle_epi32(acc128, _MM_SHUFFLE(1, 0, 3, 2)));
+  acc128 = _mm_add_epi32(acc128, _mm_shuffle_epi32(acc128, _MM_SHUFFLE(2, 3, 0, 1)));
+  int v = _mm_cvtsi128_si32(acc128);
+  for (; j < n; j++) {
+    v += sample[j]*fir[j];
+  }
+  return v;
+}
+#endif
+
+#if RESID_FIR_NEON
+static int convolve_neon(const short* sample, const short* fir, int n)
+{
+  int32x4_t acc0 = vdupq_n_s32(0);
+  int32x4_t acc1 = vdupq_n_s32(0);
+  int j = 0;
+  for (; j + 8 <= n; j += 8) {
+    int16x8_t s = vld1q_s16(sample + j);
+    int16x8_t f = vld1q_s16(fir + j);
+    acc0 = vmlal_s16(acc0, vget_low_s16(s), vget_low_s16(f));
+    acc1 = vmlal_high_s16(acc1, s, f);
+  }
+  int v = vaddvq_s32(vaddq_s32(acc0, acc1));
+  for (; j < n; j++) {
+    v += sample[j]*fir[j];
+  }
+  return v;
+}
+#endif
+
+static fir_kernel_func select_fir_kernel()
+{
+#if RESID_FIR_AVX2
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return convolve_avx2;
+  }
+#endif
+#if RESID_FIR_SSE2
+  return convolve_sse2;
+#elif RESID_FIR_NEON
+  return convolve_neon;
+#else
+  return convolve_scalar;
+#endif
+}
+
+static const fir_kernel_func convolve = select_fir_kernel();
+
+
+// ----------------------------------------------------------------------------
+// Shared FIR tables.
+//
+// The FIR tables only depend on the sampling parameters, and are expensive
+// to calculate (in particular for SAMPLE_RESAMPLE_FASTMEM, which yields
+// tables of several MB). The tables are therefore kept in a process-wide
+// cache, and are shared read-only by all SID instances using the same
+// parameters. Tables are reference counted; unreferenced tables are kept
+// for reuse until flush_fir_cache() is called.
+//
+// Lookups walk the list without locking, so that a real-time thread can
+// find a prepared table; tables are only inserted at the head, under the
+// lock, and are not modified once published.
+// ----------------------------------------------------------------------------
+struct SID::FIRTable
+{
+  double clock_freq;
+  double sample_freq;
+  double pass_freq;
+  double filter_scale;
+  int res;
+
+  int fir_N;
+  int fir_RES;
+  short* fir;
+
+  std::atomic<int> refcount;
+  FIRTable* next;
+};
+
+static std::mutex fir_cache_mutex;
+static std::atomic<SID::FIRTable*> fir_cache(0);
+
+SID::FIRTable* SID::acquire_fir_table(double clock_freq,
+				      sampling_method method,
+				      double sample_freq, double pass_freq,
+				      double filter_scale, bool build)
+{
+  int res = method == SAMPLE_RESAMPLE ?
+    FIR_RES : FIR_RES_FASTMEM;
+
+  for (FIRTable* t = fir_cache.load(std::memory_order_acquire); t;
+       t = t->next)
+  {
+    if (t->clock_freq == clock_freq && t->sample_freq == sample_freq &&
+	t->pass_freq == pass_freq && t->filter_scale == filter_scale &&
+	t->res == res)
+    {
+      ++t->refcount;
+      return t;
+    }
+  }
+
+  if (!build) {
+    return 0;
+  }
+
+  // Calculate the table without holding the lock.
+  FIRTable* table = new (std::nothrow) FIRTable;
+  if (!table) {
+    return 0;
+  }
+  table->clock_freq = clock_freq;
+  table->sample_freq = sample_freq;
+  table->pass_freq = pass_freq;
+  table->filter_scale = filter_scale;
+  table->res = res;
+  table->refcount = 1;
+
+  const double pi = 3.1415926535897932385;
+
+  // 16 bits -> -96dB stopband attenuation.
+  const double A = -20*log10(1.0/(1 << 16));
+  // A fraction of the bandwidth is allocated to the transition band,
+  double dw = (1 - 2*pass_freq/sample_freq)*pi*2;
+  // The cutoff frequency is midway through the transition band (nyquist)
+  double wc = pi;
+
+  // For calculation of beta and N see the reference for the kaiserord
+  // function in the MATLAB Signal Processing Toolbox:
+  // http://www.mathworks.com/access/helpdesk/help/toolbox/signal/kaiserord.html
+  const double beta = 0.1102*(A - 8.7);
+  const double I0beta = I0(beta);
+
+  // The filter order will maximally be 124 with the current constraints.
+  // N >= (96.33 - 7.95)/(2.285*0.1*pi) -> N >= 123
+  // The filter order is equal to the number of zero crossings, i.e.
+  // it should be an even number (sinc is symmetric about x = 0).
+  int N = int((A - 7.95)/(2.285*dw) + 0.5);
+  N += N & 1;
+
+  double f_samples_per_cycle = sample_freq/clock_freq;
+  double f_cycles_per_sample = clock_freq/sample_freq;
+
+  // The filter length is equal to the filter order + 1.
+  // The filter length must be an odd number (sinc is symmetric about x = 0).
+  int fir_N = int(N*f_cycles_per_sample) + 1;
+  fir_N |= 1;
+
+  // We clamp the filter table resolution to 2^n, making the fixed point
+  // sample_offset a whole multiple of the filter table resolution.
+  int n = (int)ceil(log(res/f_cycles_per_sample)/log(2.0f));
+  int fir_RES = 1 << n;
+
+  // Allocate memory for FIR tables.
+  short* fir = new (std::nothrow) short[fir_N*fir_RES];
+  if (!fir) {
+    delete table;
+    return 0;
+  }
+
+  // Calculate fir_RES FIR tables for linear interpolation.
+  for (int i = 0; i < fir_RES; i++) {
+    int fir_offset = i*fir_N + fir_N/2;
+    double j_offset = double(i)/fir_RES;
+    // Calculate FIR table. This is the sinc function, weighted by the
+    // Kaiser window.
+    for (int j = -fir_N/2; j <= fir_N/2; j++) {
+      double jx = j - j_offset;
+      double wt = wc*jx/f_cycles_per_sample;
+      double temp = jx/(fir_N/2);
+      double Kaiser =
+	fabs(temp) <= 1 ? I0(beta*sqrt(1 - temp*temp))/I0beta : 0;
+      double sincwt =
+	fabs(wt) >= 1e-6 ? sin(wt)/wt : 1;
+      double val =
+	(1 << FIR_SHIFT)*filter_scale*f_samples_per_cycle*wc/pi*sincwt*Kaiser;
+      fir[fir_offset + j] = (short)round(val);
+    }
+  }
+
+  table->fir_N = fir_N;
+  table->fir_RES = fir_RES;
+  table->fir = fir;
+
+  std::lock_guard<std::mutex> lock(fir_cache_mutex);
+
+  // Another thread may have inserted the same table in the meantime.
+  for (FIRTable* t = fir_cache.load(std::memory_order_relaxed); t;
+       t = t->next)
+  {
+    if (t->clock_freq == clock_freq && t->sample_freq == sample_freq &&
+	t->pass_freq == pass_freq && t->filter_scale == filter_scale &&
+	t->res == res)
+    {
+      ++t->refcount;
+      delete[] table->fir;
+      delete table;
+      return t;
+    }
+  }
+
+  table->next = fir_cache.load(std::memory_order_relaxed);
+  fir_cache.store(table, std::memory_order_release);
+  return table;
+}
+
+void SID::release_fir_table(FIRTable* table)
+{
+  if (table) {
+    --table->refcount;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Free all unreferenced FIR tables in the shared cache.
+// ----------------------------------------------------------------------------
+void SID::flush_fir_cache()
+{
+  std::lock_guard<std::mutex> lock(fir_cache_mutex);
+  FIRTable* kept = 0;
+  FIRTable** tail = &kept;
+  FIRTable* t = fir_cache.load(std::memory_order_relaxed);
+  while (t) {
+    FIRTable* next = t->next;
+    if (t->refcount <= 0) {
+      delete[] t->fir;
+      delete t;
+    }
+    else {
+      *tail = t;
+      tail = &t->next;
+    }
+    t = next;
+  }
+  *tail = 0;
+  fir_cache.store(kept, std::memory_order_release);
+}
+
+
+// ----------------------------------------------------------------------------
+// Build the FIR table for a set of sampling parameters into the cache, e.g.
+// on a non real-time thread ahead of set_sampling_parameters(). Returns
+// false if the parameters are not valid or the table could not be built.
+// ----------------------------------------------------------------------------
+bool SID::prepare_fir_table(double clock_freq, sampling_method method,
+			    double sample_freq, double pass_freq,
+			    double filter_scale)
+{
+  if (!check_sampling_parameters(clock_freq, method, sample_freq, pass_freq,
+				 filter_scale))
+  {
+    return false;
+  }
+  if (method != SAMPLE_RESAMPLE && method != SAMPLE_RESAMPLE_FASTMEM) {
+    return true;
+  }
+
+  FIRTable* table = acquire_fir_table(clock_freq, method, sample_freq,
+				      pass_freq, filter_scale, true);
+  release_fir_table(table);
+  return table != 0;
+}
+
+// ----------------------------------------------------------------------------
+// Enable building of FIR tables in set_sampling_parameters(); disable it on
+// real-time threads, and use prepare_fir_table() instead.
+// ----------------------------------------------------------------------------
+void SID::enable_fir_table_build(bool enable)
+{
+  fir_build = enable;
+}
+
+
 // ----------------------------------------------------------------------------
 // Setting of SID sampling parameters.
 //
@@ -492,7 +964,16 @@ double SID::I0(double x)
 //   125*clock_freq/sample_freq < 16384
 // E.g. provided a clock frequency of ~ 1MHz, the sample frequency can not
 // be set lower than ~ 8kHz. A lower sample frequency would make the
-// resampling code overfill its 16k sample ring buffer.
+// resampling code overfill the largest, 16k sample ring buffer.
+//
+// The ring buffer is sized to the FIR length, and is reused when the
+// parameters change and it is large enough, also across switches to the
+// methods without resampling; it is only freed with the SID or by
+// set_allocator(). The FIR tables come from the shared cache. Switching
+// e.g. between 44.1kHz and 48kHz therefore only allocates when a larger
+// ring buffer is needed. With FIR table building
+// disabled, a table missing from the cache makes the call fail and fall
+// back to SAMPLE_FAST, see prepare_fir_table().
 // 
 // The end of passband frequency is also limited:
 //   pass_freq <= 0.9*sample_freq/2
@@ -501,15 +982,16 @@ double SID::I0(double x)
 // to slightly below 20kHz. This constraint ensures that the FIR table is
 // not overfilled.
 // ----------------------------------------------------------------------------
-bool SID::set_sampling_parameters(double clock_freq, sampling_method method,
-				  double sample_freq, double pass_freq,
-				  double filter_scale)
+bool SID::check_sampling_parameters(double clock_freq,
+				    sampling_method method,
+				    double sample_freq, double& pass_freq,
+				    double filter_scale)
 {
   // Check resampling constraints.
   if (method == SAMPLE_RESAMPLE || method == SAMPLE_RESAMPLE_FASTMEM)
   {
     // Check whether the sample ring buffer would overfill.
-    if (FIR_N*clock_freq/sample_freq >= RINGSIZE) {
+    if (FIR_N*clock_freq/sample_freq >= RINGSIZE_MAX) {
       return false;
     }
 
@@ -533,6 +1015,19 @@ bool SID::set_sampling_parameters(double clock_freq, sampling_method method,
     }
   }
 
+  return true;
+}
+
+bool SID::set_sampling_parameters(double clock_freq, sampling_method method,
+				  double sample_freq, double pass_freq,
+				  double filter_scale)
+{
+  if (!check_sampling_parameters(clock_freq, method, sample_freq, pass_freq,
+				 filter_scale))
+  {
+    return false;
+  }
+
   clock_frequency = clock_freq;
   sampling = method;
 
@@ -543,83 +1038,56 @@ bool SID::set_sampling_parameters(double clock_freq, sampling_method method,
   sample_prev = 0;
   sample_now = 0;
 
-  // FIR initialization is only necessary for resampling.
+  // FIR initialization is only necessary for resampling. The ring buffer
+  // is kept for a later switch back to resampling.
   if (method != SAMPLE_RESAMPLE && method != SAMPLE_RESAMPLE_FASTMEM)
   {
-    delete[] sample;
-    delete[] fir;
-    sample = 0;
+    release_fir_table(fir_table);
+    fir_table = 0;
     fir = 0;
     return true;
   }
 
-  const double pi = 3.1415926535897932385;
-
-  // 16 bits -> -96dB stopband attenuation.
-  const double A = -20*log10(1.0/(1 << 16));
-  // A fraction of the bandwidth is allocated to the transition band,
-  double dw = (1 - 2*pass_freq/sample_freq)*pi*2;
-  // The cutoff frequency is midway through the transition band (nyquist)
-  double wc = pi;
-
-  // For calculation of beta and N see the reference for the kaiserord
-  // function in the MATLAB Signal Processing Toolbox:
-  // http://www.mathworks.com/access/helpdesk/help/toolbox/signal/kaiserord.html
-  const double beta = 0.1102*(A - 8.7);
-  const double I0beta = I0(beta);
-
-  // The filter order will maximally be 124 with the current constraints.
-  // N >= (96.33 - 7.95)/(2.285*0.1*pi) -> N >= 123
-  // The filter order is equal to the number of zero crossings, i.e.
-  // it should be an even number (sinc is symmetric about x = 0).
-  int N = int((A - 7.95)/(2.285*dw) + 0.5);
-  N += N & 1;
-
-  double f_samples_per_cycle = sample_freq/clock_freq;
-  double f_cycles_per_sample = clock_freq/sample_freq;
-
-  // The filter length is equal to the filter order + 1.
-  // The filter length must be an odd number (sinc is symmetric about x = 0).
-  fir_N = int(N*f_cycles_per_sample) + 1;
-  fir_N |= 1;
+  // Look up the FIR table in the shared cache, building it if necessary
+  // and enabled.
+  FIRTable* table = acquire_fir_table(clock_freq, method, sample_freq,
+				      pass_freq, filter_scale, fir_build);
+  release_fir_table(fir_table);
+  fir_table = table;
 
-  // We clamp the filter table resolution to 2^n, making the fixed point
-  // sample_offset a whole multiple of the filter table resolution.
-  int res = method == SAMPLE_RESAMPLE ?
-    FIR_RES : FIR_RES_FASTMEM;
-  int n = (int)ceil(log(res/f_cycles_per_sample)/log(2.0f));
-  fir_RES = 1 << n;
+  if (!fir_table) {
+    fir = 0;
+    sampling = SAMPLE_FAST;
+    return false;
+  }
 
-  // Allocate memory for FIR tables.
-  delete[] fir;
-  fir = new short[fir_N*fir_RES];
+  fir = fir_table->fir;
+  fir_N = fir_table->fir_N;
+  fir_RES = fir_table->fir_RES;
 
-  // Calculate fir_RES FIR tables for linear interpolation.
-  for (int i = 0; i < fir_RES; i++) {
-    int fir_offset = i*fir_N + fir_N/2;
-    double j_offset = double(i)/fir_RES;
-    // Calculate FIR table. This is the sinc function, weighted by the
-    // Kaiser window.
-    for (int j = -fir_N/2; j <= fir_N/2; j++) {
-      double jx = j - j_offset;
-      double wt = wc*jx/f_cycles_per_sample;
-      double temp = jx/(fir_N/2);
-      double Kaiser =
-	fabs(temp) <= 1 ? I0(beta*sqrt(1 - temp*temp))/I0beta : 0;
-      double sincwt =
-	fabs(wt) >= 1e-6 ? sin(wt)/wt : 1;
-      double val =
-	(1 << FIR_SHIFT)*filter_scale*f_samples_per_cycle*wc/pi*sincwt*Kaiser;
-      fir[fir_offset + j] = (short)round(val);
-    }
+  // The ring buffer holds twice the FIR window, which leaves at least a
+  // window's worth of cycles for a batch in clock_resample_block(). At
+  // 44.1kHz this takes 16kB instead of 64kB, at 96kHz 1kB.
+  ring_size = 1;
+  while (ring_size < 2*(fir_N + 2) && ring_size < RINGSIZE_MAX) {
+    ring_size <<= 1;
   }
+  ring_mask = ring_size - 1;
 
-  // Allocate sample buffer.
+  // Allocate sample buffer, unless the current one is large enough.
+  if (sample_capacity < ring_size*2) {
+    free_samples(sample);
+    sample = alloc_samples(ring_size*2);
+    sample_capacity = sample ? ring_size*2 : 0;
+  }
   if (!sample) {
-    sample = new short[RINGSIZE*2];
+    free_resampling_buffers();
+    sampling = SAMPLE_FAST;
+    return false;
   }
+
   // Clear sample buffer.
-  for (int j = 0; j < RINGSIZE*2; j++) {
+  for (int j = 0; j < ring_size*2; j++) {
     sample[j] = 0;
   }
   sample_index = 0;
@@ -741,6 +1209,71 @@ void SID::clock(cycle_count delta_t)
 }
 
 
+// ----------------------------------------------------------------------------
+// Sample sinks.
+// The sampling methods hand each output sample to a sink, either as a 16 bit
+// sample from the chip model, or as a FIR convolution result which is
+// FIR_SHIFT bits above the 16 bit range.
+// ShortSink stores 16 bit samples, saturating the convolution results.
+// FloatSink stores floats normalized to [-1, 1) with a gain multiply; the
+// convolution results keep their extra precision and are not saturated.
+// ----------------------------------------------------------------------------
+class SID::ShortSink
+{
+public:
+  ShortSink(short* buf, int interleave) : buf(buf), interleave(interleave) {}
+
+  void sample(int s, short v)
+  {
+    buf[s*interleave] = v;
+  }
+
+  void fir_sample(int s, int v)
+  {
+    v >>= FIR_SHIFT;
+
+    // Saturated arithmetics to guard against 16 bit sample overflow.
+    const int half = 1 << 15;
+    if (v >= half) {
+      v = half - 1;
+    }
+    else if (v < -half) {
+      v = -half;
+    }
+
+    buf[s*interleave] = v;
+  }
+
+private:
+  short* buf;
+  int interleave;
+};
+
+class SID::FloatSink
+{
+public:
+  FloatSink(float* buf, float gain, int interleave) :
+    buf(buf), scale(gain*(1.0f/(1 << 15))),
+    fir_scale(gain*(1.0f/(1 << (15 + FIR_SHIFT)))), interleave(interleave) {}
+
+  void sample(int s, short v)
+  {
+    buf[s*interleave] = v*scale;
+  }
+
+  void fir_sample(int s, int v)
+  {
+    buf[s*interleave] = v*fir_scale;
+  }
+
+private:
+  float* buf;
+  float scale;
+  float fir_scale;
+  int interleave;
+};
+
+
 // ----------------------------------------------------------------------------
 // SID clocking with audio sampling.
 // Fixed point arithmetics are used.
@@ -757,16 +1290,64 @@ void SID::clock(cycle_count delta_t)
 // ----------------------------------------------------------------------------
 int SID::clock(cycle_count& delta_t, short* buf, int n, int interleave)
 {
+  return clock_sampled(delta_t, ShortSink(buf, interleave), n);
+}
+
+int SID::clock(cycle_count& delta_t, float* buf, int n, float gain,
+	       int interleave)
+{
+  return clock_sampled(delta_t, FloatSink(buf, gain, interleave), n);
+}
+
+template<class Sink>
+int SID::clock_sampled(cycle_count& delta_t, Sink out, int n)
+{
+  switch (sampling) {
+  default:
+  case SAMPLE_FAST:
+    return clock_fast(delta_t, out, n);
+  case SAMPLE_INTERPOLATE:
+    return clock_interpolate(delta_t, out, n);
+  case SAMPLE_RESAMPLE:
+    return clock_resample(delta_t, out, n);
+  case SAMPLE_RESAMPLE_FASTMEM:
+    return clock_resample_fastmem(delta_t, out, n);
+  }
+}
+
+
+// ----------------------------------------------------------------------------
+// SID clocking with audio sampling - fixed number of samples.
+//
+// This is the natural interface for block based hosts: exactly n samples
+// are produced, and the number of cycles clocked follows from the sampling
+// parameters. The fractional cycle position is carried over between calls.
+// ----------------------------------------------------------------------------
+int SID::clock(short* buf, int n, int interleave)
+{
+  return clock_block(ShortSink(buf, interleave), n);
+}
+
+int SID::clock(float* buf, int n, float gain, int interleave)
+{
+  return clock_block(FloatSink(buf, gain, interleave), n);
+}
+
+template<class Sink>
+int SID::clock_block(Sink out, int n)
+{
+  // Large enough to never run out before n samples are produced.
+  cycle_count delta_t = 1 << 30;
+
   switch (sampling) {
   default:
   case SAMPLE_FAST:
-    return clock_fast(delta_t, buf, n, interleave);
+    return clock_fast(delta_t, out, n);
   case SAMPLE_INTERPOLATE:
-    return clock_interpolate(delta_t, buf, n, interleave);
+    return clock_interpolate(delta_t, out, n);
   case SAMPLE_RESAMPLE:
-    return clock_resample(delta_t, buf, n, interleave);
   case SAMPLE_RESAMPLE_FASTMEM:
-    return clock_resample_fastmem(delta_t, buf, n, interleave);
+    return clock_resample_block(out, n);
   }
 }
 
@@ -774,8 +1355,8 @@ int SID::clock(cycle_count& delta_t, short* buf, int n, int interleave)
 // ----------------------------------------------------------------------------
 // SID clocking with audio sampling - delta clocking picking nearest sample.
 // ----------------------------------------------------------------------------
-int SID::clock_fast(cycle_count& delta_t, short* buf, int n,
-		    int interleave)
+template<class Sink>
+int SID::clock_fast(cycle_count& delta_t, Sink out, int n)
 {
   int s;
 
@@ -795,7 +1376,7 @@ int SID::clock_fast(cycle_count& delta_t, short* buf, int n,
     }
 
     sample_offset = (next_sample_offset & FIXP_MASK) - (1 << (FIXP_SHIFT - 1));
-    buf[s*interleave] = output();
+    out.sample(s, output());
   }
 
   return s;
@@ -811,8 +1392,8 @@ int SID::clock_fast(cycle_count& delta_t, short* buf, int n,
 // external filter attenuates frequencies above 16kHz, thus reducing
 // sampling noise.
 // ----------------------------------------------------------------------------
-int SID::clock_interpolate(cycle_count& delta_t, short* buf, int n,
-			   int interleave)
+template<class Sink>
+int SID::clock_interpolate(cycle_count& delta_t, Sink out, int n)
 {
   int s;
 
@@ -839,8 +1420,8 @@ int SID::clock_interpolate(cycle_count& delta_t, short* buf, int n,
 
     sample_offset = next_sample_offset & FIXP_MASK;
 
-    buf[s*interleave] =
-      sample_prev + (sample_offset*(sample_now - sample_prev) >> FIXP_SHIFT);
+    out.sample(s,
+	       sample_prev + (sample_offset*(sample_now - sample_prev) >> FIXP_SHIFT));
   }
 
   return s;
@@ -883,8 +1464,8 @@ int SID::clock_interpolate(cycle_count& delta_t, short* buf, int n,
 // NB! the result of right shifting negative numbers is really
 // implementation dependent in the C++ standard.
 // ----------------------------------------------------------------------------
-int SID::clock_resample(cycle_count& delta_t, short* buf, int n,
-			int interleave)
+template<class Sink>
+int SID::clock_resample(cycle_count& delta_t, Sink out, int n)
 {
   int s;
 
@@ -898,8 +1479,8 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n,
 
     for (int i = 0; i < delta_t_sample; i++) {
       clock();
-      sample[sample_index] = sample[sample_index + RINGSIZE] = output();
-      ++sample_index &= RINGMASK;
+      sample[sample_index] = sample[sample_index + ring_size] = output();
+      ++sample_index &= ring_mask;
     }
 
     if ((delta_t -= delta_t_sample) == 0) {
@@ -911,14 +1492,11 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n,
 
     int fir_offset = sample_offset*fir_RES >> FIXP_SHIFT;
     int fir_offset_rmd = sample_offset*fir_RES & FIXP_MASK;
-    short* fir_start = fir + fir_offset*fir_N;
-    short* sample_start = sample + sample_index - fir_N - 1 + RINGSIZE;
+    const short* fir_start = fir + fir_offset*fir_N;
+    short* sample_start = sample + sample_index - fir_N - 1 + ring_size;
 
     // Convolution with filter impulse response.
-    int v1 = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v1 += sample_start[j]*fir_start[j];
-    }
+    int v1 = convolve(sample_start, fir_start, fir_N);
 
     // Use next FIR table, wrap around to first FIR table using
     // next sample.
@@ -929,28 +1507,14 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n,
     fir_start = fir + fir_offset*fir_N;
 
     // Convolution with filter impulse response.
-    int v2 = 0;
-    for (int k = 0; k < fir_N; k++) {
-      v2 += sample_start[k]*fir_start[k];
-    }
+    int v2 = convolve(sample_start, fir_start, fir_N);
 
     // Linear interpolation.
     // fir_offset_rmd is equal for all samples, it can thus be factorized out:
     // sum(v1 + rmd*(v2 - v1)) = sum(v1) + rmd*(sum(v2) - sum(v1))
     int v = v1 + (fir_offset_rmd*(v2 - v1) >> FIXP_SHIFT);
 
-    v >>= FIR_SHIFT;
-
-    // Saturated arithmetics to guard against 16 bit sample overflow.
-    const int half = 1 << 15;
-    if (v >= half) {
-      v = half - 1;
-    }
-    else if (v < -half) {
-      v = -half;
-    }
-
-    buf[s*interleave] = v;
+    out.fir_sample(s, v);
   }
 
   return s;
@@ -960,8 +1524,8 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n,
 // ----------------------------------------------------------------------------
 // SID clocking with audio sampling - cycle based with audio resampling.
 // ----------------------------------------------------------------------------
-int SID::clock_resample_fastmem(cycle_count& delta_t, short* buf, int n,
-				int interleave)
+template<class Sink>
+int SID::clock_resample_fastmem(cycle_count& delta_t, Sink out, int n)
 {
   int s;
 
@@ -975,8 +1539,8 @@ int SID::clock_resample_fastmem(cycle_count& delta_t, short* buf, int n,
 
     for (int i = 0; i < delta_t_sample; i++) {
       clock();
-      sample[sample_index] = sample[sample_index + RINGSIZE] = output();
-      ++sample_index &= RINGMASK;
+      sample[sample_index] = sample[sample_index + ring_size] = output();
+      ++sample_index &= ring_mask;
     }
 
     if ((delta_t -= delta_t_sample) == 0) {
@@ -987,27 +1551,104 @@ int SID::clock_resample_fastmem(cycle_count& delta_t, short* buf, int n,
     sample_offset = next_sample_offset & FIXP_MASK;
 
     int fir_offset = sample_offset*fir_RES >> FIXP_SHIFT;
-    short* fir_start = fir + fir_offset*fir_N;
-    short* sample_start = sample + sample_index - fir_N + RINGSIZE;
+    const short* fir_start = fir + fir_offset*fir_N;
+    short* sample_start = sample + sample_index - fir_N + ring_size;
 
     // Convolution with filter impulse response.
-    int v = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v += sample_start[j]*fir_start[j];
-    }
+    int v = convolve(sample_start, fir_start, fir_N);
 
-    v >>= FIR_SHIFT;
+    out.fir_sample(s, v);
+  }
 
-    // Saturated arithmetics to guard against 16 bit sample overflow.
-    const int half = 1 << 15;
-    if (v >= half) {
-      v = half - 1;
-    }
-    else if (v < -half) {
-      v = -half;
+  return s;
+}
+
+
+// ----------------------------------------------------------------------------
+// SID clocking with audio sampling - block based audio resampling.
+//
+// clock_resample() and clock_resample_fastmem() alternate between clocking
+// the chip model and convolving, which repeatedly evicts the filter model
+// tables and the FIR table from the cache. Here all cycles for a batch of
+// samples are clocked into the ring buffer first, remembering the ring
+// position and FIR phase of each sample, and the convolutions are then run
+// back to back.
+//
+// A batch is closed before the cycles clocked into the ring buffer could
+// overwrite the oldest sample still needed by the first convolution of the
+// batch. The results are identical to those of the per-sample functions.
+// ----------------------------------------------------------------------------
+template<class Sink>
+int SID::clock_resample_block(Sink out, int n)
+{
+  const int batch_max = 256;
+  int batch_ring_index[batch_max];
+  cycle_count batch_offset[batch_max];
+
+  // Cycles which can be clocked into the ring buffer before the window of
+  // the first convolution in the batch is overwritten.
+  const int cycles_max = ring_size - fir_N - 2;
+  const bool interpolate = sampling == SAMPLE_RESAMPLE;
+
+  int s = 0;
+
+  while (s < n) {
+    // Clock the chip model for a batch of samples.
+    int batch = 0;
+    int cycles = 0;
+
+    while (s + batch < n && batch < batch_max) {
+      cycle_count next_sample_offset = sample_offset + cycles_per_sample;
+      cycle_count delta_t_sample = next_sample_offset >> FIXP_SHIFT;
+
+      if (batch > 0 && cycles + delta_t_sample > cycles_max) {
+	break;
+      }
+      cycles += delta_t_sample;
+
+      for (int i = 0; i < delta_t_sample; i++) {
+	clock();
+	sample[sample_index] = sample[sample_index + ring_size] = output();
+	++sample_index &= ring_mask;
+      }
+
+      sample_offset = next_sample_offset & FIXP_MASK;
+
+      batch_ring_index[batch] = sample_index;
+      batch_offset[batch] = sample_offset;
+      batch++;
     }
 
-    buf[s*interleave] = v;
+    // Run the convolutions for the batch.
+    for (int b = 0; b < batch; b++, s++) {
+      int fir_offset = batch_offset[b]*fir_RES >> FIXP_SHIFT;
+      const short* fir_start = fir + fir_offset*fir_N;
+      int v;
+
+      if (interpolate) {
+	int fir_offset_rmd = batch_offset[b]*fir_RES & FIXP_MASK;
+	short* sample_start =
+	  sample + batch_ring_index[b] - fir_N - 1 + ring_size;
+
+	int v1 = convolve(sample_start, fir_start, fir_N);
+
+	if (unlikely(++fir_offset == fir_RES)) {
+	  fir_offset = 0;
+	  ++sample_start;
+	}
+	fir_start = fir + fir_offset*fir_N;
+
+	int v2 = convolve(sample_start, fir_start, fir_N);
+
+	v = v1 + (fir_offset_rmd*(v2 - v1) >> FIXP_SHIFT);
+      }
+      else {
+	short* sample_start = sample + batch_ring_index[b] - fir_N + ring_size;
+	v = convolve(sample_start, fir_start, fir_N);
+      }
+
+      out.fir_sample(s, v);
+    }
   }
 
   return s;
@@ -27,6 +27,7 @@
 #include "filter.h"
 #include "extfilt.h"
 #include "pot.h"
+#include <cstddef>
 
 namespace reSID
 {
@@ -47,15 +48,48 @@ public:
 			       double filter_scale = 0.97);
   void adjust_sampling_frequency(double sample_freq);
 
+  // Memory hooks for the per-instance resampling buffer (sample ring buffer).
+  // The default hooks use operator new / delete. FIR tables are not
+  // allocated through the hooks, since they are shared, see
+  // flush_fir_cache().
+  typedef void* (*alloc_func)(void* context, std::size_t size);
+  typedef void (*free_func)(void* context, void* ptr);
+  void set_allocator(alloc_func alloc, free_func free, void* context);
+
+  // FIR tables for the resampling methods. prepare_fir_table() builds the
+  // table for a set of sampling parameters into the process-wide cache.
+  // With table building disabled, set_sampling_parameters() only looks the
+  // table up, without locks or allocation, and fails if it is not cached.
+  static bool prepare_fir_table(double clock_freq, sampling_method method,
+				double sample_freq, double pass_freq = -1,
+				double filter_scale = 0.97);
+  void enable_fir_table_build(bool enable);
+
+  // Release unreferenced FIR tables from the process-wide cache. Not to be
+  // called while other threads set sampling parameters.
+  static void flush_fir_cache();
+
+  struct FIRTable;
+
   void clock();
   void clock(cycle_count delta_t);
   int clock(cycle_count& delta_t, short* buf, int n, int interleave = 1);
+  // Render exactly n samples, clocking as many cycles as required.
+  int clock(short* buf, int n, int interleave = 1);
+  // Float output, normalized to [-1, 1) and multiplied by gain. The
+  // resampling methods skip the 16 bit rounding and saturation.
+  int clock(cycle_count& delta_t, float* buf, int n, float gain = 1.0f,
+	    int interleave = 1);
+  int clock(float* buf, int n, float gain = 1.0f, int interleave = 1);
   void reset();
 
   // Read/write registers.
   reg8 read(reg8 offset);
   void write(reg8 offset, reg8 value);
 
+  // All three envelopes frozen at zero.
+  bool voices_silent();
+
   // Read/write state.
   class State
   {
@@ -76,6 +110,9 @@ public:
     cycle_count shift_pipeline[3];
     reg16 pulse_output[3];
     cycle_count floating_output_ttl[3];
+    reg12 waveform_output[3];
+    reg12 osc3[3];
+    reg12 tri_saw_pipeline[3];
 
     reg16 rate_counter[3];
     reg16 rate_counter_period[3];
@@ -85,6 +122,12 @@ public:
     EnvelopeGenerator::State envelope_state[3];
     bool hold_zero[3];
     cycle_count envelope_pipeline[3];
+
+    // Filter integrators and external filter.
+    int filter_Vhp;
+    int filter_Vbp, filter_Vbp_x, filter_Vbp_vc;
+    int filter_Vlp, filter_Vlp_x, filter_Vlp_vc;
+    int extfilt_vlp, extfilt_vhp;
   };
 
   State read_state();
@@ -98,14 +141,41 @@ public:
 
  protected:
   static double I0(double x);
-  int clock_fast(cycle_count& delta_t, short* buf, int n, int interleave);
-  int clock_interpolate(cycle_count& delta_t, short* buf, int n,
-			int interleave);
-  int clock_resample(cycle_count& delta_t, short* buf, int n, int interleave);
-  int clock_resample_fastmem(cycle_count& delta_t, short* buf, int n,
-			     int interleave);
+
+  // Sample sinks for the sampling methods, see sid.cc.
+  class ShortSink;
+  class FloatSink;
+
+  template<class Sink>
+  int clock_sampled(cycle_count& delta_t, Sink out, int n);
+  template<class Sink>
+  int clock_block(Sink out, int n);
+  template<class Sink>
+  int clock_fast(cycle_count& delta_t, Sink out, int n);
+  template<class Sink>
+  int clock_interpolate(cycle_count& delta_t, Sink out, int n);
+  template<class Sink>
+  int clock_resample(cycle_count& delta_t, Sink out, int n);
+  template<class Sink>
+  int clock_resample_fastmem(cycle_count& delta_t, Sink out, int n);
+  template<class Sink>
+  int clock_resample_block(Sink out, int n);
   void write();
 
+  static bool check_sampling_parameters(double clock_freq,
+					sampling_method method,
+					double sample_freq, double& pass_freq,
+					double filter_scale);
+  static FIRTable* acquire_fir_table(double clock_freq,
+				     sampling_method method,
+				     double sample_freq, double pass_freq,
+				     double filter_scale, bool build);
+  static void release_fir_table(FIRTable* table);
+
+  short* alloc_samples(int n);
+  void free_samples(short* ptr);
+  void free_resampling_buffers();
+
   chip_model sid_model;
   Voice voice[3];
   Filter filter;
@@ -138,8 +208,9 @@ public:
     FIR_RES_FASTMEM = 51473,
     FIR_SHIFT = 15,
 
-    RINGSIZE = 1 << 14,
-    RINGMASK = RINGSIZE - 1,
+    // Upper limit of the sample ring buffer size; the ring itself is sized
+    // to the FIR length, see set_sampling_parameters().
+    RINGSIZE_MAX = 1 << 14,
 
     // Fixed point constants (16.16 bits).
     FIXP_SHIFT = 16,
@@ -155,11 +226,23 @@ public:
   int fir_N;
   int fir_RES;
 
-  // Ring buffer with overflow for contiguous storage of RINGSIZE samples.
+  // Ring buffer with overflow for contiguous storage of ring_size samples,
+  // allocated for sample_capacity shorts.
   short* sample;
-
-  // FIR_RES filter tables (FIR_N*FIR_RES).
-  short* fir;
+  int ring_size;
+  int ring_mask;
+  int sample_capacity;
+
+  // FIR_RES filter tables (FIR_N*FIR_RES), shared read-only with other
+  // instances using the same sampling parameters.
+  FIRTable* fir_table;
+  const short* fir;
+  bool fir_build;
+
+  // Memory hooks.
+  alloc_func mem_alloc;
+  free_func mem_free;
+  void* mem_context;
 };
 
 
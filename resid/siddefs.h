@@ -26,6 +26,12 @@
 #define RESID_BRANCH_HINTS 1
 #define RESID_FPGA_CODE 0
 
+// Compact filter gain tables, see filter.h. The library and everything
+// including its headers must agree on this setting.
+#ifndef RESID_COMPACT_TABLES
+#define RESID_COMPACT_TABLES 0
+#endif
+
 // Compiler specifics.
 #define RESID_CONSTEVAL 
 #define RESID_CONSTEXPR const
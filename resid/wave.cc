@@ -20,6 +20,7 @@
 #define RESID_WAVE_CC
 
 #include "wave.h"
+#include <mutex>
 
 namespace reSID
 {
@@ -65,6 +66,9 @@ unsigned short WaveformGenerator::model_wave[2][8][1 << 12] = {
 };
 
 
+reg8 WaveformGenerator::model_wave_flags[2][16];
+
+
 // DAC lookup tables for 12-bit DACs.
 // MOS 6581: 2R/R ~ 2.20, missing termination resistor.
 // MOS 8580: 2R/R ~ 2.00, correct termination.
@@ -75,31 +79,60 @@ RESID_CONSTINIT const DAC<12> WaveformGenerator::model_dac[2] = {
 
 
 // ----------------------------------------------------------------------------
-// Constructor.
+// Class initialization.
+// Calculates the tables for the normal waveforms and the waveform flags; the
+// combined waveforms are static data. This is done once per process, either
+// explicitly before any real-time thread constructs a WaveformGenerator, or
+// by the first constructor call. Safe to call concurrently.
+// The DAC tables need no initialization here, they are constant initialized.
 // ----------------------------------------------------------------------------
-WaveformGenerator::WaveformGenerator()
-{
-  static bool class_init;
+static std::once_flag class_init_flag;
 
-  if (!class_init) {
-    // Calculate tables for normal waveforms.
-    accumulator = 0;
-    for (int i = 0; i < (1 << 12); i++) {
-      reg24 msb = accumulator & 0x800000;
-
-      // Noise mask, triangle, sawtooth, pulse mask.
-      // The triangle calculation is made branch-free, just for the hell of it.
-      model_wave[0][0][i] = model_wave[1][0][i] = 0xfff;
-      model_wave[0][1][i] = model_wave[1][1][i] =
-	((accumulator ^ -!!msb) >> 11) & 0xffe;
-      model_wave[0][2][i] = model_wave[1][2][i] = accumulator >> 12;
-      model_wave[0][4][i] = model_wave[1][4][i] = 0xfff;
-
-      accumulator += 0x1000;
-    }
+void WaveformGenerator::build_tables()
+{
+  reg24 accumulator = 0;
+  for (int i = 0; i < (1 << 12); i++) {
+    reg24 msb = accumulator & 0x800000;
+
+    // Noise mask, triangle, sawtooth, pulse mask.
+    // The triangle calculation is made branch-free, just for the hell of it.
+    model_wave[0][0][i] = model_wave[1][0][i] = 0xfff;
+    model_wave[0][1][i] = model_wave[1][1][i] =
+      ((accumulator ^ -!!msb) >> 11) & 0xffe;
+    model_wave[0][2][i] = model_wave[1][2][i] = accumulator >> 12;
+    model_wave[0][4][i] = model_wave[1][4][i] = 0xfff;
+
+    accumulator += 0x1000;
+  }
 
-    class_init = true;
+  for (int waveform = 0; waveform < 16; waveform++) {
+    bool noise_pulse = (waveform & 0xc) == 0xc;
+    bool combined_saw = (waveform & 0x2) && (waveform & 0xd);
+    bool noise_writeback = waveform > 0x8;
+
+    model_wave_flags[MOS6581][waveform] =
+      (noise_pulse ? WAVE_NOISE_PULSE_6581 : 0) |
+      (combined_saw ? WAVE_MSB_PULLDOWN : 0) |
+      (noise_writeback ? WAVE_NOISE_WRITEBACK : 0);
+    model_wave_flags[MOS8580][waveform] =
+      (noise_pulse ? WAVE_NOISE_PULSE_8580 : 0) |
+      ((waveform & 0x3) ? WAVE_TRI_SAW_DELAY : 0) |
+      (noise_writeback ? WAVE_NOISE_WRITEBACK : 0);
   }
+}
+
+void WaveformGenerator::class_init()
+{
+  std::call_once(class_init_flag, build_tables);
+}
+
+
+// ----------------------------------------------------------------------------
+// Constructor.
+// ----------------------------------------------------------------------------
+WaveformGenerator::WaveformGenerator()
+{
+  class_init();
 
   sync_source = this;
 
@@ -131,6 +164,7 @@ void WaveformGenerator::set_chip_model(chip_model model)
 {
   sid_model = model;
   wave = model_wave[model][waveform & 0x7];
+  wave_flags = model_wave_flags[model][waveform];
 }
 
 
@@ -195,6 +229,7 @@ void WaveformGenerator::writeCONTROL_REG(reg8 control)
 
   // Set up waveform table.
   wave = model_wave[sid_model][waveform & 0x7];
+  wave_flags = model_wave_flags[sid_model][waveform];
 
   // Substitution of accumulator MSB when sawtooth = 0, ring_mod = 1.
   ring_msb_mask = ((~control >> 5) & (control >> 2) & 0x1) << 23;
@@ -279,6 +314,7 @@ void WaveformGenerator::reset()
   sync = 0;
 
   wave = model_wave[sid_model][0];
+  wave_flags = 0;
 
   ring_msb_mask = 0;
   no_noise = 0xfff;
@@ -39,6 +39,9 @@ class WaveformGenerator
 public:
   WaveformGenerator();
 
+  // Build the shared waveform tables; done implicitly by the first constructor.
+  static void class_init();
+
   void set_sync_source(WaveformGenerator*);
   void set_chip_model(chip_model model);
 
@@ -65,7 +68,10 @@ public:
   void set_waveform_output(cycle_count delta_t);
 
 public:
+  static void build_tables();
+
   void clock_shift_register();
+  void clock_shift_register(reg24 n);
   void write_shift_register();
   void reset_shift_register();
   void set_noise_output();
@@ -102,6 +108,20 @@ public:
   // The control register right-shifted 4 bits; used for waveform table lookup.
   reg8 waveform;
 
+  // Side effects of the selected waveform that set_waveform_output() has to
+  // emulate on top of the table lookup. They only depend on the waveform and
+  // the chip model, and are looked up in model_wave_flags on control register
+  // writes, so that the common single waveforms take a single branch per
+  // cycle.
+  enum {
+    WAVE_NOISE_PULSE_6581 = 0x01, // noise + pulse, pulse pulls down noise
+    WAVE_NOISE_PULSE_8580 = 0x02,
+    WAVE_TRI_SAW_DELAY    = 0x04, // 8580 triangle/sawtooth OSC3 pipeline
+    WAVE_MSB_PULLDOWN     = 0x08, // 6581 combined sawtooth drives the MSB low
+    WAVE_NOISE_WRITEBACK  = 0x10  // combined noise writes the shift register
+  };
+  reg8 wave_flags;
+
   // 8580 tri/saw pipeline
   reg12 tri_saw_pipeline;
   reg12 osc3;
@@ -122,6 +142,7 @@ public:
   // Sample data for waveforms, not including noise.
   unsigned short* wave;
   static unsigned short model_wave[2][8][1 << 12];
+  static reg8 model_wave_flags[2][16];
   // DAC lookup tables.
   static const DAC<12> model_dac[2];
 
@@ -206,35 +227,30 @@ void WaveformGenerator::clock(cycle_count delta_t)
     // will be lost. It is not worth the trouble to flush the pipeline here.
 
     // Shift noise register once for each time accumulator bit 19 is set high.
-    // Bit 19 is set high each time 2^20 (0x100000) is added to the accumulator.
-    reg24 shift_period = 0x100000;
-
-    while (delta_accumulator) {
-      if (likely(delta_accumulator < shift_period)) {
-        shift_period = delta_accumulator;
-        // Determine whether bit 19 is set on the last period.
-        // NB! Requires two's complement integer.
-        if (likely(shift_period <= 0x080000)) {
-          // Check for flip from 0 to 1.
-          if (((accumulator - shift_period) & 0x080000) || !(accumulator & 0x080000))
-            {
-              break;
-            }
-        }
-        else {
-          // Check for flip from 0 (to 1 or via 1 to 0) or from 1 via 0 to 1.
-          if (((accumulator - shift_period) & 0x080000) && !(accumulator & 0x080000))
-            {
-              break;
-            }
-        }
+    // Bit 19 is set high each time 2^20 (0x100000) is added to the accumulator,
+    // plus possibly once more on the last, partial period.
+    // NB! The two-cycle pipeline delay is only modeled for 1 cycle clocking.
+    reg24 shift_count = delta_accumulator >> 20;
+    reg24 shift_period = delta_accumulator & 0x0fffff;
+
+    if (shift_period) {
+      // Determine whether bit 19 is set on the last period.
+      // NB! Requires two's complement integer.
+      reg24 accumulator_prev = accumulator - shift_period;
+      if (likely(shift_period <= 0x080000)) {
+        // Check for flip from 0 to 1.
+        shift_count +=
+          !(accumulator_prev & 0x080000) && (accumulator & 0x080000);
       }
+      else {
+        // Check for flip from 0 (to 1 or via 1 to 0) or from 1 via 0 to 1.
+        shift_count +=
+          !(accumulator_prev & 0x080000) || (accumulator & 0x080000);
+      }
+    }
 
-      // Shift the noise/random register.
-      // NB! The two-cycle pipeline delay is only modeled for 1 cycle clocking.
-      clock_shift_register();
-
-      delta_accumulator -= shift_period;
+    if (shift_count) {
+      clock_shift_register(shift_count);
     }
 
     // Calculate pulse high/low.
@@ -327,6 +343,30 @@ RESID_INLINE void WaveformGenerator::clock_shift_register()
   set_noise_output();
 }
 
+// Shift the register n times at once.
+// Each shift feeds bit22 ^ bit17 into bit 0, so the first 18 feedback bits
+// only depend on bits already in the register, and can be calculated in
+// parallel: shift i yields bit (22 - i) ^ bit (17 - i), ending up in bit
+// (n - 1 - i). Longer jumps are done in steps of 18.
+// No combined waveform writeback may happen between the shifts; this holds
+// for delta_t clocking, where write_shift_register() is only called from
+// set_waveform_output() after the clocking.
+RESID_INLINE void WaveformGenerator::clock_shift_register(reg24 n)
+{
+  for (; n > 18; n -= 18) {
+    shift_register =
+      ((shift_register << 18) |
+       (((shift_register >> 5) ^ shift_register) & 0x3ffff)) & 0x7fffff;
+  }
+
+  reg24 feedback = ((shift_register >> (23 - n)) ^ (shift_register >> (18 - n)));
+  shift_register =
+    ((shift_register << n) | (feedback & ((1 << n) - 1))) & 0x7fffff;
+
+  // New noise waveform output.
+  set_noise_output();
+}
+
 RESID_INLINE void WaveformGenerator::write_shift_register()
 {
   // Write changes to the shift register output caused by combined waveforms
@@ -583,34 +623,38 @@ void WaveformGenerator::set_waveform_output()
     waveform_output = wave[ix] & (no_pulse | pulse_output) & no_noise_or_noise_output;
 #endif
 
-    if (unlikely((waveform & 0xc) == 0xc))
-    {
-        waveform_output = (sid_model == MOS6581) ?
-            noise_pulse6581(waveform_output) : noise_pulse8580(waveform_output);
+    if (likely(!wave_flags)) {
+      osc3 = waveform_output;
     }
+    else {
+      if (unlikely(wave_flags & WAVE_NOISE_PULSE_6581)) {
+        waveform_output = noise_pulse6581(waveform_output);
+      }
+      else if (unlikely(wave_flags & WAVE_NOISE_PULSE_8580)) {
+        waveform_output = noise_pulse8580(waveform_output);
+      }
 
-    // Triangle/Sawtooth output is delayed half cycle on 8580.
-    // This will appear as a one cycle delay on OSC3 as it is
-    // latched in the first phase of the clock.
-    if ((waveform & 3) && (sid_model == MOS8580))
-    {
+      // Triangle/Sawtooth output is delayed half cycle on 8580.
+      // This will appear as a one cycle delay on OSC3 as it is
+      // latched in the first phase of the clock.
+      if (wave_flags & WAVE_TRI_SAW_DELAY) {
         osc3 = tri_saw_pipeline & (no_pulse | pulse_output) & no_noise_or_noise_output;
         tri_saw_pipeline = wave[ix];
-    }
-    else
-    {
+      }
+      else {
         osc3 = waveform_output;
-    }
+      }
 
-    if ((waveform & 0x2) && unlikely(waveform & 0xd) && (sid_model == MOS6581)) {
+      if (wave_flags & WAVE_MSB_PULLDOWN) {
         // In the 6581 the top bit of the accumulator may be driven low by combined waveforms
         // when the sawtooth is selected
         accumulator &= (waveform_output << 12) | 0x7fffff;
-    }
+      }
 
-    if (unlikely(waveform > 0x8) && likely(!test) && likely(shift_pipeline != 1)) {
-      // Combined waveforms write to the shift register.
-      write_shift_register();
+      if ((wave_flags & WAVE_NOISE_WRITEBACK) && likely(!test) && likely(shift_pipeline != 1)) {
+        // Combined waveforms write to the shift register.
+        write_shift_register();
+      }
     }
   }
   else {
@@ -648,15 +692,17 @@ void WaveformGenerator::set_waveform_output(cycle_count delta_t)
     // Triangle/Sawtooth output delay for the 8580 is not modeled
     osc3 = waveform_output;
 
-    if ((waveform & 0x2) && unlikely(waveform & 0xd) && (sid_model == MOS6581)) {
+    if (unlikely(wave_flags & (WAVE_MSB_PULLDOWN | WAVE_NOISE_WRITEBACK))) {
+      if (wave_flags & WAVE_MSB_PULLDOWN) {
         accumulator &= (waveform_output << 12) | 0x7fffff;
-    }
+      }
 
-    if (unlikely(waveform > 0x8) && likely(!test)) {
-      // Combined waveforms write to the shift register.
-      // NB! Since cycles are skipped in delta_t clocking, writes will be
-      // missed. Single cycle clocking must be used for 100% correct operation.
-      write_shift_register();
+      if ((wave_flags & WAVE_NOISE_WRITEBACK) && likely(!test)) {
+        // Combined waveforms write to the shift register.
+        // NB! Since cycles are skipped in delta_t clocking, writes will be
+        // missed. Single cycle clocking must be used for 100% correct operation.
+        write_shift_register();
+      }
     }
   }
   else {
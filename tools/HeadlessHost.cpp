@@ -0,0 +1,138 @@
+#include "HeadlessHost.hpp"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+
+extern "C" void load(InterfaceTable* inTable);
+extern "C" void unload();
+
+namespace {
+
+struct UnitDef {
+    size_t size;
+    UnitCtorFunc ctor;
+    UnitDtorFunc dtor;
+};
+
+// Filled by load(), read only afterwards.
+std::map<std::string, UnitDef> gUnitDefs;
+
+InterfaceTable gTable;
+
+int hostPrint(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    const int n = std::vfprintf(stderr, fmt, args);
+    va_end(args);
+    return n;
+}
+
+void* hostRTAlloc(World*, size_t size) { return std::malloc(size); }
+void hostRTFree(World*, void* ptr) { std::free(ptr); }
+
+bool hostDefineUnit(const char* name, size_t size, UnitCtorFunc ctor, UnitDtorFunc dtor, uint32) {
+    gUnitDefs[name] = UnitDef{ size, ctor, dtor };
+    return true;
+}
+
+bool hostDefineUnitCmd(const char*, const char*, UnitCmdFunc) { return true; }
+bool hostDefinePlugInCmd(const char*, PlugInCmdFunc, void*) { return true; }
+
+// All stages run right away, as on a non real-time server.
+bool hostDoAsynchronousCommand(World* world, void*, const char*, void* data, AsyncStageFn stage2,
+                               AsyncStageFn stage3, AsyncStageFn stage4, AsyncFreeFn cleanup, int, void*) {
+    if ((!stage2 || stage2(world, data)) && (!stage3 || stage3(world, data)) && stage4) {
+        stage4(world, data);
+    }
+    if (cleanup) {
+        cleanup(world, data);
+    }
+    return true;
+}
+void hostDoneAction(int, Unit*) {}
+void hostSendNodeReply(Node*, int, const char*, int, const float*) {}
+
+void hostClearUnitOutputs(Unit* unit, int n) {
+    for (uint32 i = 0; i < unit->mNumOutputs; i++) {
+        std::memset(unit->mOutBuf[i], 0, n * sizeof(float));
+    }
+}
+
+} // namespace
+
+void loadHeadlessPlugin() {
+    gTable.fPrint = hostPrint;
+    gTable.fRTAlloc = hostRTAlloc;
+    gTable.fRTFree = hostRTFree;
+    gTable.fDefineUnit = hostDefineUnit;
+    gTable.fDefineUnitCmd = hostDefineUnitCmd;
+    gTable.fDefinePlugInCmd = hostDefinePlugInCmd;
+    gTable.fDoAsynchronousCommand = hostDoAsynchronousCommand;
+    gTable.fDoneAction = hostDoneAction;
+    gTable.fSendNodeReply = hostSendNodeReply;
+    gTable.fClearUnitOutputs = hostClearUnitOutputs;
+    load(&gTable);
+}
+
+void unloadHeadlessPlugin() {
+    unload();
+}
+
+bool headlessUnitExists(const char* name) {
+    return gUnitDefs.count(name) != 0;
+}
+
+HeadlessHost::HeadlessHost(double sampleRate, int blockSize) : world(), rate(), graph() {
+    rate.mSampleRate = sampleRate;
+    rate.mSampleDur = 1.0 / sampleRate;
+    rate.mBufLength = blockSize;
+    rate.mBufDuration = blockSize / sampleRate;
+    rate.mBufRate = sampleRate / blockSize;
+    rate.mSlopeFactor = 1.0 / blockSize;
+    world.mSampleRate = sampleRate;
+    world.mBufLength = blockSize;
+    world.mFullRate = &rate;
+    world.mBufRate = &rate;
+}
+
+HeadlessUnit::HeadlessUnit(HeadlessHost& host, const char* name, const std::vector<float>& values,
+                           int numOutputs, const std::vector<int>& rates) {
+    const UnitDef& def = gUnitDefs.at(name);
+    const int blockSize = host.rate.mBufLength;
+    mDtor = def.dtor;
+    mUnit = static_cast<Unit*>(std::calloc(1, def.size));
+    mInputs.assign(values.size(), std::vector<float>(blockSize));
+    mOutputs.assign(numOutputs, std::vector<float>(blockSize));
+    mWires.resize(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        std::fill(mInputs[i].begin(), mInputs[i].end(), values[i]);
+        mWires[i].mBuffer = mInputs[i].data();
+        mWires[i].mCalcRate = i < rates.size() ? rates[i] : calc_BufRate;
+        mWirePtrs.push_back(&mWires[i]);
+        mInPtrs.push_back(mInputs[i].data());
+    }
+    for (int o = 0; o < numOutputs; o++) {
+        mOutPtrs.push_back(mOutputs[o].data());
+    }
+    mUnit->mWorld = &host.world;
+    mUnit->mParent = &host.graph;
+    mUnit->mRate = &host.rate;
+    mUnit->mBufLength = blockSize;
+    mUnit->mNumInputs = static_cast<uint32>(values.size());
+    mUnit->mNumOutputs = numOutputs;
+    mUnit->mInput = mWirePtrs.data();
+    mUnit->mInBuf = mInPtrs.data();
+    mUnit->mOutBuf = mOutPtrs.data();
+    def.ctor(mUnit);
+}
+
+HeadlessUnit::~HeadlessUnit() {
+    if (mDtor) {
+        mDtor(mUnit);
+    }
+    std::free(mUnit);
+}
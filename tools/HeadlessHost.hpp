@@ -0,0 +1,61 @@
+#pragma once
+
+// Headless plugin host for the tools: a minimal InterfaceTable and World are
+// set up here, the plugin is loaded through its regular load() entry point,
+// and the calc functions are called directly.
+
+#include "SC_PlugIn.hpp"
+#include <vector>
+
+// Loads the plugin; call once, before any unit is made. Plugin messages go
+// to stderr, node replies and doneActions are dropped, and asynchronous
+// commands complete before they return.
+void loadHeadlessPlugin();
+
+// Stops the plugin, through its unload() entry point; call once all units
+// are gone.
+void unloadHeadlessPlugin();
+
+bool headlessUnitExists(const char* name);
+
+// The sample rate and block size of a set of units, which keep a pointer to
+// it. Hosts are independent of each other, so units of different hosts can
+// run on different threads.
+struct HeadlessHost {
+    HeadlessHost(double sampleRate, int blockSize);
+
+    World world;
+    Rate rate;
+    Graph graph;
+};
+
+// A unit with constant inputs, until they are changed through input().
+// rates holds the calc rate of each input (calc_ScalarRate, calc_BufRate or
+// calc_FullRate); inputs past its end are control rate.
+class HeadlessUnit {
+public:
+    HeadlessUnit(HeadlessHost& host, const char* name, const std::vector<float>& values, int numOutputs,
+                 const std::vector<int>& rates = {});
+    ~HeadlessUnit();
+
+    HeadlessUnit(const HeadlessUnit&) = delete;
+    HeadlessUnit& operator=(const HeadlessUnit&) = delete;
+
+    // One block of input or output samples; a scalar or control rate input
+    // only has its first sample read by the unit, and a scalar one only in
+    // the constructor, as a rule.
+    float* input(int i) { return mInputs[i].data(); }
+    const float* output(int o) const { return mOutputs[o].data(); }
+
+    void next() { (mUnit->mCalcFunc)(mUnit, mUnit->mBufLength); }
+
+private:
+    Unit* mUnit;
+    UnitDtorFunc mDtor;
+    std::vector<std::vector<float>> mInputs;
+    std::vector<std::vector<float>> mOutputs;
+    std::vector<Wire> mWires;
+    std::vector<Wire*> mWirePtrs;
+    std::vector<float*> mInPtrs;
+    std::vector<float*> mOutPtrs;
+};
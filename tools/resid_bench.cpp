@@ -0,0 +1,248 @@
+// resid_bench: timings for the reSID and SIDOsc hot paths.
+//
+// The plugin units are run headless, through HeadlessHost.
+//
+// Usage: resid_bench [seconds per measurement]
+
+#include "HeadlessHost.hpp"
+#include "SIDDefs.hpp"
+#include "sid.h"
+#include "filter.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace reSID;
+using SIDOsc::kClockFreq;
+
+namespace {
+
+constexpr double kSampleRate = 44100.0;
+
+double gSeconds = 0.5;
+
+// Keeps results alive, so that the measured work is not optimized away.
+volatile int gSink;
+
+using Clock = std::chrono::steady_clock;
+
+double elapsed(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Set up a SID the way SIDOscFull does: all voices sounding.
+void setupSID(SID& sid, chip_model model) {
+    sid.set_chip_model(model);
+    for (int v = 0; v < 3; v++) {
+        sid.write(v * 7 + 0x00, 0x00);
+        sid.write(v * 7 + 0x01, 0x1d); // ~440 Hz
+        sid.write(v * 7 + 0x03, 0x08);
+        sid.write(v * 7 + 0x05, 0x00);
+        sid.write(v * 7 + 0x06, 0xF0);
+        sid.write(v * 7 + 0x04, 0x21);
+    }
+    sid.write(0x17, 0xF7); // all voices through the filter, full resonance
+    sid.write(0x16, 0x40);
+    sid.write(0x18, 0x1F);
+}
+
+// ----------------------------------------------------------------------------
+// reSID
+// ----------------------------------------------------------------------------
+
+void benchSingleCycle(chip_model model) {
+    SID sid;
+    setupSID(sid, model);
+    const int cycles = static_cast<int>(kClockFreq * gSeconds);
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < cycles; i++) {
+        sid.clock();
+    }
+    const double t = elapsed(start);
+    gSink = sid.output();
+    std::printf("%-36s %12.2f Mcycles/s %10.3f x realtime\n",
+                model == MOS6581 ? "SID::clock() 6581" : "SID::clock() 8580",
+                cycles / t * 1e-6, cycles / kClockFreq / t);
+}
+
+void benchDeltaClock(cycle_count delta) {
+    SID sid;
+    setupSID(sid, MOS6581);
+    const int steps = static_cast<int>(kClockFreq * gSeconds / delta);
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < steps; i++) {
+        sid.clock(delta);
+    }
+    const double t = elapsed(start);
+    gSink = sid.output();
+    char name[64];
+    std::snprintf(name, sizeof(name), "SID::clock(delta_t = %d)", delta);
+    std::printf("%-36s %12.2f Mcycles/s %10.3f x realtime\n",
+                name, steps * static_cast<double>(delta) / t * 1e-6,
+                steps * delta / kClockFreq / t);
+}
+
+void benchSampling(sampling_method method, int blockSize) {
+    static const char* names[] = { "fast", "interpolate", "resample", "resample fastmem" };
+    SID sid;
+    setupSID(sid, MOS6581);
+    if (!sid.set_sampling_parameters(kClockFreq, method, kSampleRate)) {
+        std::printf("SID::clock(buf, n) %-17s unsupported\n", names[method]);
+        return;
+    }
+    std::vector<short> buf(blockSize);
+    const int blocks = static_cast<int>(kSampleRate * gSeconds / blockSize) + 1;
+    const Clock::time_point start = Clock::now();
+    for (int b = 0; b < blocks; b++) {
+        sid.clock(buf.data(), blockSize);
+    }
+    const double t = elapsed(start);
+    gSink = buf[0];
+    char name[64];
+    std::snprintf(name, sizeof(name), "SID::clock(buf, %d) %s", blockSize, names[method]);
+    const double samples = static_cast<double>(blocks) * blockSize;
+    std::printf("%-36s %12.1f ns/sample %10.3f x realtime\n",
+                name, t / samples * 1e9, samples / kSampleRate / t);
+}
+
+void benchFilter(chip_model model, bool delta) {
+    Filter filter;
+    filter.set_chip_model(model);
+    filter.enable_filter(true);
+    filter.writeFC_LO(0x07);
+    filter.writeFC_HI(0x40);
+    filter.writeRES_FILT(0xF7);
+    filter.writeMODE_VOL(0x1F);
+    const int cycles = static_cast<int>(kClockFreq * gSeconds);
+    // A crude sawtooth on each voice input.
+    int v = 0;
+    const Clock::time_point start = Clock::now();
+    if (delta) {
+        for (int i = 0; i < cycles; i += 22) {
+            v = (v + 22 * 0x100) & 0xfffff;
+            filter.clock(22, v - 0x80000, v - 0x80000, v - 0x80000);
+        }
+    }
+    else {
+        for (int i = 0; i < cycles; i++) {
+            v = (v + 0x100) & 0xfffff;
+            filter.clock(v - 0x80000, v - 0x80000, v - 0x80000);
+        }
+    }
+    const double t = elapsed(start);
+    gSink = filter.output();
+    char name[64];
+    std::snprintf(name, sizeof(name), "Filter::clock(%s) %s", delta ? "22" : "",
+                  model == MOS6581 ? "6581" : "8580");
+    std::printf("%-36s %12.2f Mcycles/s %10.3f x realtime\n",
+                name, cycles / t * 1e-6, cycles / kClockFreq / t);
+}
+
+// ----------------------------------------------------------------------------
+// Headless plugin units
+// ----------------------------------------------------------------------------
+
+void benchUnit(const char* label, const char* name, const std::vector<float>& values,
+               int numOutputs, int instances, int blockSize, bool audioRateFreq = false) {
+    HeadlessHost host(kSampleRate, blockSize);
+    std::vector<HeadlessUnit*> units;
+    const Clock::time_point constructStart = Clock::now();
+    for (int i = 0; i < instances; i++) {
+        units.push_back(new HeadlessUnit(host, name, values, numOutputs,
+                                         { audioRateFreq ? calc_FullRate : calc_BufRate }));
+    }
+    const double constructTime = elapsed(constructStart);
+
+    // An audio-rate input gets a slow glide, so that the frequency
+    // registers really change every sample.
+    if (audioRateFreq) {
+        for (HeadlessUnit* u : units) {
+            for (int j = 0; j < blockSize; j++) {
+                u->input(0)[j] = values[0] + j * 0.1f;
+            }
+        }
+    }
+
+    const int blocks = static_cast<int>(kSampleRate * gSeconds / blockSize) + 1;
+    const Clock::time_point start = Clock::now();
+    for (int b = 0; b < blocks; b++) {
+        for (HeadlessUnit* u : units) {
+            u->next();
+        }
+    }
+    const double t = elapsed(start);
+    gSink = static_cast<int>(units[0]->output(0)[0]);
+    for (HeadlessUnit* u : units) {
+        delete u;
+    }
+
+    char fullLabel[96];
+    std::snprintf(fullLabel, sizeof(fullLabel), "%s x%d, block %d", label, instances, blockSize);
+    const double samples = static_cast<double>(blocks) * blockSize;
+    std::printf("%-36s %12.1f ns/sample %10.3f x realtime %8.1f us/ctor\n",
+                fullLabel, t / samples * 1e9, samples / kSampleRate / t,
+                constructTime / instances * 1e6);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        gSeconds = std::atof(argv[1]);
+        if (gSeconds <= 0.0) {
+            std::fprintf(stderr, "usage: %s [seconds per measurement]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    loadHeadlessPlugin();
+
+    std::printf("== reSID\n");
+    benchSingleCycle(MOS6581);
+    benchSingleCycle(MOS8580);
+    benchDeltaClock(22);
+    benchDeltaClock(1000);
+    for (int method = SAMPLE_FAST; method <= SAMPLE_RESAMPLE_FASTMEM; method++) {
+        for (int blockSize : { 64, 1024 }) {
+            benchSampling(static_cast<sampling_method>(method), blockSize);
+        }
+    }
+    benchFilter(MOS6581, false);
+    benchFilter(MOS8580, false);
+    benchFilter(MOS6581, true);
+    benchFilter(MOS8580, true);
+
+    std::printf("== Plugin units\n");
+    for (int blockSize : { 64, 256 }) {
+        for (int instances : { 1, 16 }) {
+            // freq, gain, waveform, dacType, gate, sampling
+            benchUnit("SIDOsc legacy", "SIDOsc", { 440, 1, 2, 0, 1, -1 }, 1, instances, blockSize);
+            benchUnit("SIDOsc", "SIDOsc", { 440, 1, 2, 0, 1, 0 }, 1, instances, blockSize);
+            benchUnit("SIDOsc blep", "SIDOsc", { 440, 1, 2, 0, 1, 1 }, 1, instances, blockSize);
+            for (int method = SAMPLE_FAST; method <= SAMPLE_RESAMPLE_FASTMEM; method++) {
+                char label[32];
+                std::snprintf(label, sizeof(label), "SIDOscFull %d", method);
+                benchUnit(label, "SIDOscFull", { 440, 1, 2, 0, 1, static_cast<float>(method) }, 1, instances, blockSize);
+            }
+        }
+    }
+    benchUnit("SIDOsc ar freq", "SIDOsc", { 440, 1, 2, 0, 1, 0 }, 1, 1, 64, true);
+    benchUnit("SIDOscFull 2 ar freq", "SIDOscFull", { 440, 1, 2, 0, 1, 2 }, 1, 1, 64, true);
+
+    for (int chips : { 16, 128 }) {
+        for (int threaded : { 0, 1 }) {
+            // gain, waveform, dacType, gate, threaded, freqs...
+            std::vector<float> values = { 1, 2, 0, 1, static_cast<float>(threaded) };
+            for (int c = 0; c < chips; c++) {
+                values.push_back(110.0f + 5.0f * c);
+            }
+            char label[32];
+            std::snprintf(label, sizeof(label), "SIDBank %d chips%s", chips, threaded ? " threaded" : "");
+            benchUnit(label, "SIDBank", values, chips, 1, 64);
+        }
+    }
+
+    unloadHeadlessPlugin();
+    return 0;
+}
@@ -0,0 +1,456 @@
+// sidosc_render: offline rendering of plugin units and of a bare reSID chip,
+// from scripted timelines, as fast as the machine allows.
+//
+// Usage: sidosc_render [-j jobs] [-c] script...
+//
+// Each script renders one file. The scripts are rendered in parallel on up to
+// jobs threads, one thread per core by default. With -c nothing is written:
+// each render is compared with its existing output file instead, and the exit
+// status is 1 if any sample differs, for regression tests against golden
+// files.
+//
+// Script lines, one statement each; '#' starts a comment, and numbers may be
+// written in hex (0x):
+//
+//   output <path>             .wav writes a 32-bit float WAV, anything else
+//                             raw interleaved floats; default: the script
+//                             path with a .wav extension
+//   samplerate <Hz>           default 44100
+//   length <seconds>          required for units; a chip renders up to its
+//                             last register write by default
+//
+//   unit <name> <outputs>     render a plugin unit, e.g. SIDOsc 1
+//   block <samples>           block size, default 64
+//   inputs <value>...         initial input values, in UGen input order
+//   audio <input>             make an input audio rate
+//   scalar <input>            make an input scalar rate (ir), e.g. the
+//                             SIDOsc waveform, which selects its kernel
+//   set <seconds> <input> <value>
+//                             change an input value. Control rate inputs
+//                             change at the first block starting at or after
+//                             the time, audio rate inputs at its sample;
+//                             scalar inputs cannot change
+//
+//   chip <model> <sampling>   render a reSID chip: model 6581 or 8580,
+//                             sampling 0-3 as for SIDOscFull
+//   write <cycles> <register> <value>
+//                             register write, <cycles> SID cycles after the
+//                             previous one, as in SIDPlayer streams
+
+#include "HeadlessHost.hpp"
+#include "SIDDefs.hpp"
+#include "sid.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace reSID;
+using SIDOsc::kClockFreq;
+
+namespace {
+
+struct InputChange {
+    double time;
+    int input;
+    float value;
+};
+
+struct RegisterWrite {
+    cycle_count cycles;
+    reg8 address;
+    reg8 value;
+};
+
+struct Script {
+    std::string path;
+    std::string output;
+    double sampleRate = 44100.0;
+    double length = -1.0;
+
+    // Plugin unit.
+    std::string unit;
+    int numOutputs = 1;
+    int blockSize = 64;
+    std::vector<float> inputs;
+    std::vector<int> rates; // calc_BufRate, calc_FullRate or calc_ScalarRate
+    std::vector<InputChange> changes;
+
+    // reSID chip.
+    bool chip = false;
+    chip_model model = MOS6581;
+    sampling_method sampling = SAMPLE_FAST;
+    std::vector<RegisterWrite> writes;
+};
+
+struct Render {
+    Script script;
+    std::string error;
+    std::vector<float> samples; // interleaved
+    int channels = 1;
+    double seconds = 0.0;
+    bool differs = false;
+};
+
+bool parseNumber(const std::string& token, double& value) {
+    char* end;
+    value = std::strtod(token.c_str(), &end);
+    return !token.empty() && *end == '\0' && std::isfinite(value);
+}
+
+bool parseScript(Script& script, std::string& error) {
+    std::ifstream file(script.path);
+    if (!file) {
+        error = script.path + ": cannot open";
+        return false;
+    }
+
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); lineNumber++) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        std::string keyword;
+        if (!(tokens >> keyword)) {
+            continue;
+        }
+        std::vector<std::string> args;
+        std::string arg;
+        while (tokens >> arg) {
+            args.push_back(arg);
+        }
+        std::vector<double> numbers(args.size());
+        bool numeric = true;
+        for (size_t i = 0; i < args.size(); i++) {
+            numeric = numeric && parseNumber(args[i], numbers[i]);
+        }
+
+        auto fail = [&](const char* message) {
+            error = script.path + ":" + std::to_string(lineNumber) + ": " + message;
+            return false;
+        };
+        auto validInput = [&](double index) {
+            return index >= 0 && index < script.inputs.size() && index == std::floor(index);
+        };
+
+        if (keyword == "output" && args.size() == 1) {
+            script.output = args[0];
+        } else if (keyword == "samplerate" && args.size() == 1 && numeric) {
+            if (numbers[0] < 1000.0) {
+                return fail("sample rate out of range");
+            }
+            script.sampleRate = numbers[0];
+        } else if (keyword == "length" && args.size() == 1 && numeric) {
+            if (numbers[0] < 0.0) {
+                return fail("negative length");
+            }
+            script.length = numbers[0];
+        } else if (keyword == "unit" && args.size() == 2) {
+            if (!headlessUnitExists(args[0].c_str())) {
+                return fail("unknown unit");
+            }
+            if (!parseNumber(args[1], numbers[1]) || numbers[1] < 1 || numbers[1] > 1024) {
+                return fail("bad number of outputs");
+            }
+            script.unit = args[0];
+            script.numOutputs = static_cast<int>(numbers[1]);
+        } else if (keyword == "block" && args.size() == 1 && numeric) {
+            if (numbers[0] < 1 || numbers[0] > 8192) {
+                return fail("block size out of range");
+            }
+            script.blockSize = static_cast<int>(numbers[0]);
+        } else if (keyword == "inputs" && numeric) {
+            script.inputs.assign(numbers.begin(), numbers.end());
+            script.rates.assign(numbers.size(), calc_BufRate);
+        } else if ((keyword == "audio" || keyword == "scalar") && args.size() == 1 && numeric) {
+            if (!validInput(numbers[0])) {
+                return fail("no such input");
+            }
+            script.rates[static_cast<int>(numbers[0])] = keyword == "audio" ? calc_FullRate : calc_ScalarRate;
+        } else if (keyword == "set" && args.size() == 3 && numeric) {
+            if (!validInput(numbers[1])) {
+                return fail("no such input");
+            }
+            if (numbers[0] < 0.0) {
+                return fail("negative time");
+            }
+            script.changes.push_back(InputChange{ numbers[0], static_cast<int>(numbers[1]), static_cast<float>(numbers[2]) });
+        } else if (keyword == "chip" && args.size() == 2 && numeric) {
+            if (numbers[0] != 6581 && numbers[0] != 8580) {
+                return fail("chip model is 6581 or 8580");
+            }
+            if (numbers[1] < SAMPLE_FAST || numbers[1] > SAMPLE_RESAMPLE_FASTMEM) {
+                return fail("sampling is 0-3");
+            }
+            script.chip = true;
+            script.model = numbers[0] == 8580 ? MOS8580 : MOS6581;
+            script.sampling = static_cast<sampling_method>(static_cast<int>(numbers[1]));
+        } else if (keyword == "write" && args.size() == 3 && numeric) {
+            if (numbers[0] < 0 || numbers[0] > 1e9 || numbers[1] < 0 || numbers[1] > 0x1f
+                || numbers[2] < 0 || numbers[2] > 0xff) {
+                return fail("write out of range");
+            }
+            script.writes.push_back(RegisterWrite{ static_cast<cycle_count>(numbers[0]),
+                                                   static_cast<reg8>(numbers[1]), static_cast<reg8>(numbers[2]) });
+        } else {
+            return fail("syntax error");
+        }
+    }
+
+    if (script.chip == !script.unit.empty()) {
+        error = script.path + ": exactly one of unit and chip is required";
+        return false;
+    }
+    if (!script.chip && script.length < 0.0) {
+        error = script.path + ": length is required for units";
+        return false;
+    }
+    for (const InputChange& change : script.changes) {
+        if (script.rates[change.input] == calc_ScalarRate) {
+            error = script.path + ": scalar input " + std::to_string(change.input) + " cannot be set";
+            return false;
+        }
+    }
+    if (script.output.empty()) {
+        const size_t slash = script.path.find_last_of('/');
+        const size_t dot = script.path.find_last_of('.');
+        const bool extension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+        script.output = script.path.substr(0, extension ? dot : std::string::npos) + ".wav";
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Rendering
+// ----------------------------------------------------------------------------
+
+void renderUnit(Render& render) {
+    const Script& script = render.script;
+    const int blockSize = script.blockSize;
+    const long frames = std::lround(script.length * script.sampleRate);
+
+    // The sample each change takes effect at; control rate changes are
+    // moved to the next block boundary.
+    struct Change {
+        long sample;
+        int input;
+        float value;
+    };
+    std::vector<Change> changes;
+    for (const InputChange& change : script.changes) {
+        long sample = std::lround(change.time * script.sampleRate);
+        if (script.rates[change.input] != calc_FullRate) {
+            sample = (sample + blockSize - 1) / blockSize * blockSize;
+        }
+        changes.push_back(Change{ sample, change.input, change.value });
+    }
+    std::stable_sort(changes.begin(), changes.end(),
+                     [](const Change& a, const Change& b) { return a.sample < b.sample; });
+
+    HeadlessHost host(script.sampleRate, blockSize);
+    HeadlessUnit unit(host, script.unit.c_str(), script.inputs, script.numOutputs, script.rates);
+
+    render.channels = script.numOutputs;
+    render.samples.resize(frames * script.numOutputs);
+    size_t next = 0;
+    for (long start = 0; start < frames; start += blockSize) {
+        for (; next < changes.size() && changes[next].sample < start + blockSize; next++) {
+            const Change& change = changes[next];
+            float* input = unit.input(change.input);
+            std::fill(input + std::max(change.sample - start, 0L), input + blockSize, change.value);
+        }
+        unit.next();
+
+        const int n = static_cast<int>(std::min<long>(blockSize, frames - start));
+        float* out = render.samples.data() + start * script.numOutputs;
+        for (int o = 0; o < script.numOutputs; o++) {
+            const float* output = unit.output(o);
+            for (int i = 0; i < n; i++) {
+                out[i * script.numOutputs + o] = output[i];
+            }
+        }
+    }
+}
+
+void renderChip(Render& render) {
+    const Script& script = render.script;
+    SID sid;
+    sid.set_chip_model(script.model);
+    if (!sid.set_sampling_parameters(kClockFreq, script.sampling, script.sampleRate)) {
+        render.error = script.path + ": sampling method not supported at this sample rate";
+        return;
+    }
+
+    long frames = 0;
+    if (script.length >= 0.0) {
+        frames = std::lround(script.length * script.sampleRate);
+    } else {
+        double cycles = 0.0;
+        for (const RegisterWrite& write : script.writes) {
+            cycles += write.cycles;
+        }
+        frames = static_cast<long>(std::ceil(cycles / kClockFreq * script.sampleRate));
+    }
+
+    render.channels = 1;
+    render.samples.resize(frames);
+    float* out = render.samples.data();
+    long produced = 0;
+    for (const RegisterWrite& write : script.writes) {
+        cycle_count delta = write.cycles;
+        while (delta > 0 && produced < frames) {
+            produced += sid.clock(delta, out + produced, static_cast<int>(std::min(frames - produced, 1L << 20)));
+        }
+        if (produced == frames) {
+            break;
+        }
+        sid.write(write.address, write.value);
+    }
+    while (produced < frames) {
+        produced += sid.clock(out + produced, static_cast<int>(std::min(frames - produced, 1L << 20)));
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Output files
+// ----------------------------------------------------------------------------
+
+void appendLE(std::string& data, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        data.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+// The file contents; samples are written in host byte order, which is
+// little endian on all supported platforms.
+std::string encode(const Render& render) {
+    const uint32_t dataSize = static_cast<uint32_t>(render.samples.size() * sizeof(float));
+    std::string data;
+    const std::string& path = render.script.output;
+    if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".wav") == 0) {
+        const uint32_t channels = render.channels;
+        const uint32_t sampleRate = static_cast<uint32_t>(std::lround(render.script.sampleRate));
+        data += "RIFF";
+        appendLE(data, 50 + dataSize, 4);
+        data += "WAVEfmt ";
+        appendLE(data, 18, 4);
+        appendLE(data, 3, 2); // WAVE_FORMAT_IEEE_FLOAT
+        appendLE(data, channels, 2);
+        appendLE(data, sampleRate, 4);
+        appendLE(data, sampleRate * channels * 4, 4);
+        appendLE(data, channels * 4, 2);
+        appendLE(data, 32, 2);
+        appendLE(data, 0, 2);
+        data += "fact";
+        appendLE(data, 4, 4);
+        appendLE(data, static_cast<uint32_t>(render.samples.size() / channels), 4);
+        data += "data";
+        appendLE(data, dataSize, 4);
+    }
+    const size_t header = data.size();
+    data.resize(header + dataSize);
+    std::memcpy(&data[header], render.samples.data(), dataSize);
+    return data;
+}
+
+void store(Render& render, bool compare) {
+    const std::string data = encode(render);
+    const std::string& path = render.script.output;
+    if (!compare) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file.write(data.data(), data.size())) {
+            render.error = path + ": cannot write";
+        }
+        return;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        render.error = path + ": cannot open for comparison";
+        return;
+    }
+    const std::string golden((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    render.differs = golden != data;
+}
+
+void renderScript(Render& render, bool compare) {
+    const auto start = std::chrono::steady_clock::now();
+    if (!parseScript(render.script, render.error)) {
+        return;
+    }
+    if (render.script.chip) {
+        renderChip(render);
+    } else {
+        renderUnit(render);
+    }
+    render.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (render.error.empty()) {
+        store(render, compare);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int jobs = static_cast<int>(std::thread::hardware_concurrency());
+    bool compare = false;
+    std::vector<Render> renders;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "-c") == 0) {
+            compare = true;
+        } else {
+            renders.emplace_back();
+            renders.back().script.path = argv[i];
+        }
+    }
+    if (renders.empty() || jobs < 1) {
+        std::fprintf(stderr, "usage: %s [-j jobs] [-c] script...\n", argv[0]);
+        return 1;
+    }
+
+    loadHeadlessPlugin();
+
+    // Renders are independent; each thread takes the next one not started.
+    std::atomic<size_t> nextRender{ 0 };
+    auto worker = [&]() {
+        for (size_t i; (i = nextRender.fetch_add(1)) < renders.size();) {
+            renderScript(renders[i], compare);
+        }
+    };
+    std::vector<std::thread> threads;
+    const size_t numThreads = std::min<size_t>(jobs, renders.size());
+    for (size_t t = 1; t < numThreads; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    unloadHeadlessPlugin();
+
+    int status = 0;
+    for (const Render& render : renders) {
+        if (!render.error.empty()) {
+            std::fprintf(stderr, "%s\n", render.error.c_str());
+            status = 1;
+            continue;
+        }
+        const double length = render.samples.size() / render.channels / render.script.sampleRate;
+        std::printf("%-40s %s %8.2f s %10.1f x realtime\n", render.script.output.c_str(),
+                    compare ? (render.differs ? "DIFFERS" : "matches") : "written",
+                    length, length / std::max(render.seconds, 1e-9));
+        if (render.differs) {
+            status = 1;
+        }
+    }
+    return status;
+}